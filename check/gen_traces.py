@@ -0,0 +1,41 @@
+# Generates a small recorded/ideal Paraver trace pair for the regression check:
+# every rank alternates useful phases with an MPI call, the ideal trace has
+# the same phases with 10x shorter calls, and the other threads of a rank
+# work within an OpenMP parallel region.  Deterministic for given arguments.
+#   python3 gen_traces.py <name> <ranks> <iterations> <threads>
+# writes <name>.prv and <name>.sim.prv.
+import random, sys
+
+name= sys.argv[1]
+numRanks, numIter, numThreads= int(sys.argv[2]), int(sys.argv[3]), int(sys.argv[4])
+calls= [(50000001, 1), (50000002, 10), (50000001, 3), (50000001, 5)]
+
+def trace(ideal):
+    recs= []
+    for r in range(numRanks):
+        rnd= random.Random(r)
+        t= 1000
+        for it in range(numIter):
+            w= rnd.randint(50000, 150000)
+            recs.append((t, r, 1, "50000001:0" if it else "40000001:1:50000001:0"))
+            t+= w
+            c= rnd.choice(calls)
+            recs.append((t, r, 1, "%d:%d" % c))
+            d= rnd.randint(1000, 40000)
+            t+= d// 10 if ideal else d
+            recs.append((t, r, 1, "%d:0" % c[0]))
+            for th in range(2, numThreads+ 1):
+                recs.append((t- w// 2, r, th, "60000001:1"))
+                recs.append((t- w// 4, r, th, "60000001:0"))
+        recs.append((t, r, 1, "40000001:0"))
+    recs.sort()
+    end= max(x[0] for x in recs)
+    tasks= ",".join("%d:1" % numThreads for _ in range(numRanks))
+    lines= ["#Paraver (01/01/2024 at 00:00):%d_ns:1(%d):1:%d(%s),1" % (end, numRanks* numThreads, numRanks, tasks),
+            "c:1:1:%d:%s" % (numRanks, ":".join(str(i+ 1) for i in range(numRanks)))]
+    for (t, r, th, ev) in recs:
+        lines.append("2:%d:1:%d:%d:%d:%s" % (r* numThreads+ th, r+ 1, th, t, ev))
+    return "\n".join(lines)+ "\n"
+
+open(name+ ".prv", "w").write(trace(False))
+open(name+ ".sim.prv", "w").write(trace(True))
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Regression check: builds ideal2resolved.exe, then runs 'check' twice on
+# generated trace pairs; exits with 1 if either fails.
+# - small (4 ranks, 2 threads each): resolved.dat, pop.dat and threads.dat, and
+#   the files of a phase, an event and a time window, against check/golden.
+# - perf (64 ranks, about 12 MB per trace): the speed and the peak memory of
+#   every pass against budgets, 60% of the speed and 125% of the memory
+#   measured on the reference machine (about 300, 300 and 125 MBps, 14 MB);
+#   set BUDGET_SPEED and BUDGET_RSS to override them on another one.
+#   check/run.sh [work-dir]
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+work=${1:-$(mktemp -d)}
+mkdir -p "$work"
+cd "$work"
+gcc -O3 -o ideal2resolved.exe "$here/../source/ideal2resolved.c" -lm -lpthread
+python3 "$here/gen_traces.py" small 4 250 2
+python3 "$here/gen_traces.py" perf 64 2000 1
+cat > small.in <<END
+prv-file ../small.prv
+sim-file ../small.sim.prv
+golden-dir $here/golden
+golden-tol 1e-9
+window-phases 10
+window-events 7
+window-time 1ms
+END
+cat > perf.in <<END
+prv-file ../perf.prv
+sim-file ../perf.sim.prv
+budget-speed ${BUDGET_SPEED:-180,180,75}
+budget-rss ${BUDGET_RSS:-18}
+END
+status=0
+mkdir -p small perf
+(cd small && ../ideal2resolved.exe check ../small.in) || status=1
+(cd perf && ../ideal2resolved.exe check ../perf.in) || status=1
+exit $status
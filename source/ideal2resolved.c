@@ -13,13 +13,45 @@
 #include<string.h>
 #include<float.h>
 #include<math.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<sys/resource.h>
+#include<errno.h>
 
 PrvHeader header;
 
 static struct {
   char *prvfn;
   char *simfn;
-} Input= { NULL, NULL };
+  char *outfn;
+  char *ranks;
+  char *evttypes;
+  char *rectypes;
+  char *winPhases;
+  char *winEvents;
+  char *winTime;
+  int numThreads;
+  int sampleBlocks;
+  size_t sampleSize;
+  bool sampleRandom;
+  unsigned sampleSeed;
+  char *socketfn;
+  int monRank;
+  int monThread;
+  char *goldenDir;
+  double goldenTol;
+  char *budgetSpeed;
+  char *budgetRSS;
+} Input= { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 32, 4*1024*1024, false, 1, NULL, 0, 0,
+           NULL, 1.0e-9, NULL, NULL };
+static char *InputValue(char *const line, const int keylen)
+{
+  char *val= strtok(line+ keylen, " \n");
+  if(NULL== val) { return NULL; }
+  char *ret= (char *) malloc(sizeof(char)* (strlen(val)+ 1));
+  strcpy(ret, val);
+  return ret;
+}
 static int FileInput(const char *const arg_in)
 {
   FILE *fp= fopen(arg_in, "r");
@@ -29,15 +61,54 @@ static int FileInput(const char *const arg_in)
   int len= (int) (sizeof(line)/ sizeof(line[0]));
   while(NULL!= fgets(line, len, fp)) {
     if(0== strncmp("prv-file", line, 8)) {
-      char *fn= strtok(line+ 8, " \n");
-      Input.prvfn= (char *) malloc(sizeof(char)* (strlen(fn)+ 1));
-      memset(Input.prvfn, 0, sizeof(char)* (strlen(fn)+ 1));
-      strcpy(Input.prvfn, fn);
+      Input.prvfn= InputValue(line, 8);
     } else if(0== strncmp("sim-file", line, 8)) {
-      char *fn= strtok(line+ 8, " \n");
-      Input.simfn= (char *) malloc(sizeof(char)* (strlen(fn)+ 1));
-      memset(Input.simfn, 0, sizeof(char)* (strlen(fn)+ 1));
-      strcpy(Input.simfn, fn);
+      Input.simfn= InputValue(line, 8);
+    } else if(0== strncmp("out-file", line, 8)) {
+      Input.outfn= InputValue(line, 8);
+    } else if(0== strncmp("ranks", line, 5)) {
+      Input.ranks= InputValue(line, 5);
+    } else if(0== strncmp("event-types", line, 11)) {
+      Input.evttypes= InputValue(line, 11);
+    } else if(0== strncmp("record-types", line, 12)) {
+      Input.rectypes= InputValue(line, 12);
+    } else if(0== strncmp("window-phases", line, 13)) {
+      Input.winPhases= InputValue(line, 13);
+    } else if(0== strncmp("window-events", line, 13)) {
+      Input.winEvents= InputValue(line, 13);
+    } else if(0== strncmp("window-time", line, 11)) {
+      Input.winTime= InputValue(line, 11);
+    } else if(0== strncmp("mon-rank", line, 8)) {
+      Input.monRank= atoi(line+ 8)- 1;
+    } else if(0== strncmp("mon-thread", line, 10)) {
+      Input.monThread= atoi(line+ 10)- 1;
+    } else if(0== strncmp("golden-dir", line, 10)) {
+      Input.goldenDir= InputValue(line, 10);
+    } else if(0== strncmp("golden-tol", line, 10)) {
+      Input.goldenTol= atof(line+ 10);
+    } else if(0== strncmp("budget-speed", line, 12)) {
+      Input.budgetSpeed= InputValue(line, 12);
+    } else if(0== strncmp("budget-rss", line, 10)) {
+      Input.budgetRSS= InputValue(line, 10);
+    } else if(0== strncmp("threads", line, 7)) {
+      Input.numThreads= atoi(line+ 7);
+    } else if(0== strncmp("pin-threads", line, 11)) {
+      ImpPinThreads= 0!= atoi(line+ 11);
+    } else if(0== strncmp("sample-blocks", line, 13)) {
+      Input.sampleBlocks= atoi(line+ 13);
+    } else if(0== strncmp("sample-size", line, 11)) {
+      char *end= NULL;
+      Input.sampleSize= (size_t) strtoull(line+ 11, &end, 10);
+      while(' '== *end) { ++end; }
+      if('k'== *end|| 'K'== *end) { Input.sampleSize*= 1024; }
+      else if('M'== *end) { Input.sampleSize*= 1024* 1024; }
+      else if('G'== *end) { Input.sampleSize*= 1024* 1024* 1024; }
+    } else if(0== strncmp("sample-mode", line, 11)) {
+      Input.sampleRandom= NULL!= strstr(line+ 11, "random");
+    } else if(0== strncmp("sample-seed", line, 11)) {
+      Input.sampleSeed= (unsigned) atoi(line+ 11);
+    } else if(0== strncmp("server-socket", line, 13)) {
+      Input.socketfn= InputValue(line, 13);
     } else {
       printf("Problem reading input line (%s)\n", line);
     }
@@ -49,8 +120,8 @@ static int FileInput(const char *const arg_in)
   printf("Input.simfn= \"%s\"\n", Input.simfn);
 #endif
 
-  if(NULL== Input.prvfn|| NULL== Input.simfn) {
-    return 1;
+  if(0>= Input.numThreads) {
+    Input.numThreads= (int) MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
   }
 
   return 0;
@@ -58,42 +129,43 @@ static int FileInput(const char *const arg_in)
 
 static struct {
   struct {
-    double t;
+    ProfTime t;
     int e;
   } prv;
 
   struct {
-    double t;
+    ProfTime t;
     int e;
   } sim;
 
-  double at;
+  ProfTime at;
   bool isTracing;
-} Last= { { 0.0, -1 }, { 0.0, -1 }, 0.0, false };
-inline static void SetLastPrvEvt(const double t, const int e) { Last.prv.t= t; Last.prv.e= e; }
-inline static void SetLastSimEvt(const double t, const int e) { Last.sim.t= t; Last.sim.e= e; }
+} Last= { { 0, -1 }, { 0, -1 }, 0, false };
+inline static void SetLastPrvEvt(const ProfTime t, const int e) { Last.prv.t= t; Last.prv.e= e; }
+inline static void SetLastSimEvt(const ProfTime t, const int e) { Last.sim.t= t; Last.sim.e= e; }
 inline static void ResetLastEvts(const int resetVal)
 {
-  SetLastPrvEvt(0.0, resetVal);
-  SetLastSimEvt(0.0, resetVal);
+  SetLastPrvEvt(0, resetVal);
+  SetLastSimEvt(0, resetVal);
 }
 
 static struct {
   struct {
-    double *t;
+    ProfTime *t;
     int *e;
     long nevts;
     long ievt;
   } sim;
 
-  double (*extents)[2];
+  ProfTime (*extents)[2];
 
-  double tprog[2];
+  ProfTime tprog[2];            /* runtimes of prv and sim */
   long nevts;
   long ievt;
 
   int monRank;
-} Trace= { { NULL, NULL, 0, 0 }, NULL, { 0.0, 0.0 }, 0, 0, 0 };
+  int monThread;
+} Trace= { { NULL, NULL, 0, 0 }, NULL, { 0, 0 }, 0, 0, 0, 0 };
 
 inline static void AllocSimBeforeCount()
 {
@@ -102,18 +174,16 @@ inline static void AllocSimBeforeCount()
   Trace.sim.nevts= 0;
   Trace.sim.ievt= 0;
 
-  Trace.extents= (double (*)[2]) malloc(sizeof(double[2])* np);
+  Trace.extents= (ProfTime (*)[2]) malloc(sizeof(ProfTime[2])* np);
   for(int ip= 0; ip< np; ++ip) {
-    Trace.extents[ip][0]= Trace.extents[ip][1]= -1.0;
+    Trace.extents[ip][0]= Trace.extents[ip][1]= ProfTimeInvalid;
   }
 }
 
 inline static void AllocSimBeforeRead()
 {
-  const int np= header.numProcs;
-
-  Trace.sim.t= (double *) malloc(sizeof(double)* Trace.sim.nevts);
-  memset(Trace.sim.t, 0, sizeof(double)* Trace.sim.nevts);
+  Trace.sim.t= (ProfTime *) malloc(sizeof(ProfTime)* Trace.sim.nevts);
+  memset(Trace.sim.t, 0, sizeof(ProfTime)* Trace.sim.nevts);
 
   Trace.sim.e= (int *) malloc(sizeof(int)* Trace.sim.nevts);
   memset(Trace.sim.e, 0, sizeof(int)* Trace.sim.nevts);
@@ -123,14 +193,52 @@ inline static void AllocPrvBeforeCount()
 {
 }
 
+/* speed and peak memory of every pass, for the budgets of 'check'.  The peak
+ * (VmHWM) is reset before each pass through /proc/self/clear_refs; where that
+ * fails it is the peak of the process so far (ru_maxrss). */
+#define MAX_PASSES 16
+static struct {
+  int n;
+  double MBps[MAX_PASSES];
+  double maxRSSMB[MAX_PASSES];
+} Passes= { 0, { 0.0 }, { 0.0 } };
+static bool PassResetPeakRSS()
+{
+  FILE *fp= fopen("/proc/self/clear_refs", "w");
+  if(NULL== fp) { return false; }
+  const bool ok= 1== fwrite("5", 1, 1, fp);
+  return 0== fclose(fp)&& ok;
+}
+static double PassPeakRSSMB(const bool reset)
+{
+  if(reset) {
+    FILE *fp= fopen("/proc/self/status", "r");
+    char line[256];
+    long kB= -1;
+    while(NULL!= fp&& NULL!= fgets(line, sizeof(line), fp)) {
+      if(0== strncmp("VmHWM:", line, 6)) { kB= atol(line+ 6); break; }
+    }
+    if(NULL!= fp) { fclose(fp); fp= NULL; }
+    if(0<= kB) { return ((double) kB)/ 1024.0; }
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ((double) ru.ru_maxrss)/ 1024.0;   /* kB */
+}
 static void ProcessFile(FILE *const fp, const size_t nb,
                         void (*processor)(char *const))
 {
+  const bool reset= PassResetPeakRSS();
   ImpSetLineProcessorAndResetFreadTime(processor);
   ProfTime tRead= GetTime();
   ImpProcessParaverFileWithNumBytes(fp, nb);
   tRead= GetTime()- tRead;
-  ImpPrintSpeed(0, nb, tRead, 1);
+  const double Bps= ImpPrintSpeed(Passes.n, nb, tRead, 1);
+  if(MAX_PASSES> Passes.n) {
+    Passes.MBps[Passes.n]= Bps/ (1024.0* 1024.0);
+    Passes.maxRSSMB[Passes.n]= PassPeakRSSMB(reset);
+  }
+  ++(Passes.n);
 }
 static void SimEvtCounter(char *const line)
 {
@@ -139,8 +247,10 @@ static void SimEvtCounter(char *const line)
   char *ptr= ImpNthNum(line, 3);
   const int p= atoi(ptr)- 1;
   if(Trace.monRank!= p) { return; }
-  ptr= ImpNthNum(ptr, 2);
-  Last.at= atof(ptr);
+  ptr= ImpNthNum(ptr, 1);
+  if(Trace.monThread!= atoi(ptr)- 1) { return; }
+  ptr= ImpNthNum(ptr, 1);
+  Last.at= ImpAtoProfTime(ptr);
 
   ptr= strchr(ptr, ':');
   while(NULL!= ptr) {
@@ -169,7 +279,7 @@ static void SimEvtCounter(char *const line)
     ptr= strchr(ptr, ':');
   }
 }
-inline static void ReadSimEvt(const double t, const int e)
+inline static void ReadSimEvt(const ProfTime t, const int e)
 {
   Trace.sim.t[Trace.sim.ievt]= t;
   Trace.sim.e[Trace.sim.ievt]= e;
@@ -182,8 +292,10 @@ static void SimEvtReader(char *const line)
   char *ptr= ImpNthNum(line, 3);
   const int p= atoi(ptr)- 1;
   if(Trace.monRank!= p) { return; }
-  ptr= ImpNthNum(ptr, 2);
-  Last.at= atof(ptr);
+  ptr= ImpNthNum(ptr, 1);
+  if(Trace.monThread!= atoi(ptr)- 1) { return; }
+  ptr= ImpNthNum(ptr, 1);
+  Last.at= ImpAtoProfTime(ptr);
 
   ptr= strchr(ptr, ':');
   while(NULL!= ptr) {
@@ -225,51 +337,481 @@ inline static void SimRead(FILE *const fp, const size_t nb, const int np)
   }
 }
 
-static struct {
-  FILE *fp;
-  double (*instant)[2];
-  double cumulative[2];
-  int n;
-} Writer= { NULL, NULL, { 0.0, 0.0 }, 0 };
 #define CRITIC 0
 #define ELAPSE 1
-/* useful, critical, elapsed */
-inline static void WriteInit()
+/* Monitor windows: the last 'size' useful phases, the last 'size' MPI events,
+ * or the useful phases started within the last 'size' ns of elapsed time.
+ * Each keeps its (critical, elapsed) samples in a ring, oldest at 'head'. */
+typedef enum _WindowKind_type__ {
+  WindowPhases= 0,
+  WindowEvents,
+  WindowTime
+} WindowKind;
+typedef struct _Window_type__ {
+  WindowKind kind;
+  ProfTime size;
+  FILE *fp;
+  ProfTime (*ring)[2];
+  long cap;
+  long head;
+  long len;
+  ProfTime last[2];
+  ProfTime cumulative[2];
+} Window;
+static struct {
+  Window *w;
+  int nw;
+} Writer= { NULL, 0 };
+
+inline static ProfTime *WindowSample(const Window *const w, const long i)
 {
-  Writer.fp= fopen("resolved.dat", "w");
-  fprintf(Writer.fp, "#%14s %15s %15s %15s %15s\n",
+  return w->ring[(w->head+ i)% w->cap];
+}
+static void WindowPush(Window *const w, const ProfTime tr, const ProfTime tc)
+{
+  if(w->len== w->cap) {
+    if(WindowTime!= w->kind) {  /* fixed length: drop the oldest */
+      w->head= (w->head+ 1)% w->cap;
+      --(w->len);
+    } else {
+      ProfTime (*ring)[2]= (ProfTime (*)[2]) malloc(sizeof(ProfTime[2])* 2* w->cap);
+      for(long i= 0; i< w->len; ++i) {
+        ring[i][CRITIC]= WindowSample(w, i)[CRITIC];
+        ring[i][ELAPSE]= WindowSample(w, i)[ELAPSE];
+      }
+      FREE_IF(w->ring);
+      w->ring= ring; w->cap*= 2; w->head= 0;
+    }
+  }
+  ProfTime *const n= w->ring[(w->head+ w->len)% w->cap];
+  n[CRITIC]= tc; n[ELAPSE]= tr;
+  ++(w->len);
+  if(WindowTime== w->kind) {    /* keep the latest sample at or before tr- size */
+    while(2< w->len&& WindowSample(w, 1)[ELAPSE]<= tr- w->size) {
+      w->head= (w->head+ 1)% w->cap;
+      --(w->len);
+    }
+  }
+}
+/* false if the ring cannot be allocated */
+static bool WindowInit(Window *const w, const WindowKind kind, const ProfTime size)
+{
+  memset(w, 0, sizeof(Window));
+  w->kind= kind;
+  w->size= MAX(1, size);
+
+  /* fixed windows start filled with zeros, time windows with a single zero */
+  w->cap= WindowTime== kind? 64: (long) w->size;
+  w->ring= (ProfTime (*)[2]) malloc(sizeof(ProfTime[2])* w->cap);
+  if(NULL== w->ring) { return false; }
+  memset(w->ring, 0, sizeof(ProfTime[2])* w->cap);
+  w->head= 0;
+  w->len= WindowTime== kind? 1: w->cap;
+  return true;
+}
+static void WindowOpen(Window *const w, const WindowKind kind, const ProfTime size, const char *const fn)
+{
+  if(!WindowInit(w, kind, size)) { perror(fn); exit(0); }
+  w->fp= fopen(fn, "w");
+  if(NULL== w->fp) { perror(fn); exit(0); }
+  fprintf(w->fp, "#%14s %15s %15s %15s %15s\n",
           "t1-1", "crit-inst-2", "elps-inst-3", "crit-cum-4", "elps-cum-5");
+}
+/* Advances the window by an event; at the start of a useful phase fills the
+ * monitor row (elapsed, instantaneous critical and elapsed, cumulative
+ * critical and elapsed) and returns true */
+static bool WindowStep(Window *const w, const ProfTime tr, const ProfTime tc, const int e,
+                       ProfTime row[5])
+{
+  if(WindowEvents== w->kind) { WindowPush(w, tr, tc); }
+  if(0!= e) { return false; }   /* starting useful */
+
+  w->cumulative[CRITIC]+= tc- w->last[CRITIC];
+  w->cumulative[ELAPSE]+= tr- w->last[ELAPSE];
+  w->last[CRITIC]= tc; w->last[ELAPSE]= tr;
 
-  Writer.n= (int) sqrt(((double) header.numProcs));
-  Writer.instant= (double (*)[2]) malloc(sizeof(double[2])* Writer.n);
-  memset(Writer.instant, 0, sizeof(double[2])* Writer.n);
+  if(WindowEvents!= w->kind) { WindowPush(w, tr, tc); }
+  const ProfTime *const o= WindowSample(w, 0);
+  row[0]= w->cumulative[ELAPSE];
+  row[1]= tc- o[CRITIC];
+  row[2]= tr- o[ELAPSE];
+  row[3]= w->cumulative[CRITIC];
+  row[4]= w->cumulative[ELAPSE];
+  return true;
+}
+inline static ProfTime WindowParseSize(const char *const tok, const WindowKind kind)
+{
+  return WindowTime== kind? ImpGetTimePointNS(tok): atoll(tok);
+}
+/* Checks a window-* list before any file is opened */
+static void WindowCheckList(const char *const list, const WindowKind kind)
+{
+  if(NULL== list) { return; }
+  char *tmp= (char *) malloc(sizeof(char)* (strlen(list)+ 1));
+  strcpy(tmp, list);
+  char *save= NULL;
+  for(char *tok= strtok_r(tmp, ",", &save); NULL!= tok; tok= strtok_r(NULL, ",", &save)) {
+    if(0>= WindowParseSize(tok, kind)) {
+      printf("window-%s: size \"%s\" is not positive\n",
+             WindowPhases== kind? "phases": WindowEvents== kind? "events": "time", tok);
+      exit(0);
+    }
+  }
+  FREE_IF(tmp);
+}
+static void WindowOpenList(const char *const list, const WindowKind kind)
+{
+  if(NULL== list) { return; }
+  char *tmp= (char *) malloc(sizeof(char)* (strlen(list)+ 1));
+  strcpy(tmp, list);
+  char *save= NULL;
+  for(char *tok= strtok_r(tmp, ",", &save); NULL!= tok; tok= strtok_r(NULL, ",", &save)) {
+    const ProfTime size= WindowParseSize(tok, kind);
+    char fn[64]= { '\0' };
+    sprintf(fn, "resolved.%c%lld%s.dat", "pet"[kind], size, WindowTime== kind? "ns": "");
+    Writer.w= (Window *) realloc(Writer.w, sizeof(Window)* (Writer.nw+ 1));
+    WindowOpen(&Writer.w[Writer.nw], kind, size, fn);
+    ++(Writer.nw);
+  }
+  FREE_IF(tmp);
+}
+/* useful, critical, elapsed: resolved.dat with the default window, and one
+ * file per extra window */
+inline static void WriteInit()
+{
+  WindowCheckList(Input.winPhases, WindowPhases);
+  WindowCheckList(Input.winEvents, WindowEvents);
+  WindowCheckList(Input.winTime, WindowTime);
+  Writer.w= (Window *) malloc(sizeof(Window));
+  WindowOpen(&Writer.w[0], WindowPhases, (ProfTime) sqrt(((double) header.numProcs)), "resolved.dat");
+  Writer.nw= 1;
+  WindowOpenList(Input.winPhases, WindowPhases);
+  WindowOpenList(Input.winEvents, WindowEvents);
+  WindowOpenList(Input.winTime, WindowTime);
 }
 inline static void WriteFinalize()
 {
-  fclose(Writer.fp); Writer.fp= NULL;
+  for(int i= 0; i< Writer.nw; ++i) {
+    fclose(Writer.w[i].fp); Writer.w[i].fp= NULL;
+    FREE_IF(Writer.w[i].ring);
+  }
+  FREE_IF(Writer.w); Writer.nw= 0;
 }
-inline static void WriteOut(const double tr, const double tc, const int e)
+/* all times are kept in integer ns, converted to seconds only when written */
+inline static void WriteOut(const ProfTime tr, const ProfTime tc, const int e)
 {
+  ProfTime row[5];
+  for(int i= 0; i< Writer.nw; ++i) {
+    Window *const w= &Writer.w[i];
+    if(!WindowStep(w, tr, tc, e, row)) { continue; }
+    for(int j= 0; j< 5; ++j) {
+      ImpFprintSeconds(w->fp, row[j]); fputc(4== j? '\n': ' ', w->fp);
+    }
+  }
+}
+/* POP efficiencies from the useful time of every timeline, i.e., (task,
+ * thread): LB= avg(useful)/ max(useful), Ser= max(useful)/ T_ideal,
+ * Tr= T_ideal/ T, Comm= Ser* Tr and Par= LB* Comm.  Globally with the runtimes
+ * of both traces, as monitors up to every useful start of the monitored
+ * timeline, and over the consecutive intervals of every extra window.  Within
+ * an interval the ideal time is that of the monitored timeline, but at least
+ * the useful time of any timeline.
+ *
+ * A timeline is useful outside MPI and the OpenMP runtime; a worker thread
+ * additionally only within OpenMP work. */
+#define PRV 0
+#define SIM 1
+#define POP_IN_MPI (1u<< 31)
+#define POP_MASTER (1u<< 30)
+#define POP_OMP_WORK ((1u<< NUM_OMP_WORK_EVENTS)- 1)
+#define POP_OMP_RUNTIME (((1u<< NUM_OMP_EVENTS)- 1)& ~POP_OMP_WORK)
+/* Useful time of the timelines in an interval from 't0' on (the whole run for
+ * the cumulative one), so that its sum and maximum at any time cost O(1):
+ * closed phases per timeline, and the open ones through their start.  Those
+ * open since before the interval ('carried') all count t- t0, the others are
+ * kept in a max-heap by useful- since. */
+typedef struct _PopAcc_type__ {
+  WindowKind kind;
+  ProfTime size;
+  long count;                   /* phases or events in the interval */
+  ProfTime t0;
+  ProfTime ti0;                 /* ideal time at t0 */
+  long epoch;                   /* of the interval */
+  long *ep;                     /* per timeline: epoch of useful */
+  long *openEp;                 /* per timeline: epoch of the open phase */
+  ProfTime *useful;             /* of the closed phases */
+  int *heap;
+  int *pos;                     /* in the heap, -1 if not */
+  int numHeap;
+  ProfTime sum;                 /* of useful */
+  ProfTime max;                 /* of useful */
+  long numOpen;
+  long numCarried;
+  ProfTime sumSince;            /* of the open phases, t0 if carried */
+  FILE *fp;
+} PopAcc;
+static struct {
+  int n;
+  ProfTime *since;              /* start of the open phase */
+  unsigned *state;              /* POP_* and open OpenMP events, bit per index */
+  PopAcc acc;                   /* cumulative */
+  PopAcc *w;                    /* per extra window */
+  int nw;
+} Pop= { 0, NULL, NULL, { 0 }, NULL, 0 };
+inline static bool PopIsUseful(const unsigned st)
+{
+  if(0!= (st& (POP_IN_MPI| POP_OMP_RUNTIME))) { return false; }
+  return 0!= (st& (POP_MASTER| POP_OMP_WORK));
+}
+inline static ProfTime PopAccUseful(const PopAcc *const a, const int it)
+{
+  return a->ep[it]== a->epoch? a->useful[it]: 0;
+}
+inline static ProfTime PopAccKey(const PopAcc *const a, const int k)
+{
+  const int it= a->heap[k];
+  return PopAccUseful(a, it)- Pop.since[it];
+}
+inline static void PopAccSwap(PopAcc *const a, const int k, const int l)
+{
+  const int it= a->heap[k];
+  a->heap[k]= a->heap[l]; a->heap[l]= it;
+  a->pos[a->heap[k]]= k; a->pos[a->heap[l]]= l;
+}
+static void PopAccSift(PopAcc *const a, int k)
+{
+  while(0< k&& PopAccKey(a, (k- 1)/ 2)< PopAccKey(a, k)) {
+    PopAccSwap(a, k, (k- 1)/ 2);
+    k= (k- 1)/ 2;
+  }
+  for(;;) {
+    int m= k;
+    const int l= 2* k+ 1, r= 2* k+ 2;
+    if(l< a->numHeap&& PopAccKey(a, m)< PopAccKey(a, l)) { m= l; }
+    if(r< a->numHeap&& PopAccKey(a, m)< PopAccKey(a, r)) { m= r; }
+    if(m== k) { break; }
+    PopAccSwap(a, k, m);
+    k= m;
+  }
+}
+static void PopAccInit(PopAcc *const a, const WindowKind kind, const ProfTime size)
+{
+  /* one allocation per array for all the timelines */
+  const int n= MAX(1, Pop.n);
+  memset(a, 0, sizeof(PopAcc));
+  a->kind= kind; a->size= size;
+  a->ep= (long *) calloc(n, sizeof(long));
+  a->openEp= (long *) calloc(n, sizeof(long));
+  a->useful= (ProfTime *) calloc(n, sizeof(ProfTime));
+  a->heap= (int *) calloc(n, sizeof(int));
+  a->pos= (int *) malloc(sizeof(int)* n);
+  for(int it= 0; it< n; ++it) { a->pos[it]= -1; }
+}
+static void PopAccFree(PopAcc *const a)
+{
+  if(NULL!= a->fp) { fclose(a->fp); a->fp= NULL; }
+  FREE_IF(a->ep); FREE_IF(a->openEp); FREE_IF(a->useful); FREE_IF(a->heap); FREE_IF(a->pos);
+}
+inline static void PopAccOpen(PopAcc *const a, const int it, const ProfTime t)
+{
+  a->openEp[it]= a->epoch;
+  ++(a->numOpen);
+  a->sumSince+= t;
+  a->heap[a->numHeap]= it; a->pos[it]= a->numHeap;
+  ++(a->numHeap);
+  PopAccSift(a, a->numHeap- 1);
+}
+inline static void PopAccClose(PopAcc *const a, const int it, const ProfTime t)
+{
+  ProfTime from= a->t0;
+  if(a->openEp[it]!= a->epoch) {
+    --(a->numCarried);
+  } else {
+    from= Pop.since[it];
+    const int k= a->pos[it];
+    --(a->numHeap);
+    if(k!= a->numHeap) {
+      PopAccSwap(a, k, a->numHeap);
+      a->pos[it]= -1;
+      PopAccSift(a, k);
+    }
+    a->pos[it]= -1;
+  }
+  if(a->ep[it]!= a->epoch) { a->useful[it]= 0; a->ep[it]= a->epoch; }
+  const ProfTime u= t- from;
+  a->useful[it]+= u;
+  a->sum+= u;
+  a->max= MAX(a->max, a->useful[it]);
+  --(a->numOpen);
+  a->sumSince-= from;
+}
+/* Starts the next interval at 't', the open phases carried into it */
+static void PopAccReset(PopAcc *const a, const ProfTime t, const ProfTime ti)
+{
+  ++(a->epoch);
+  a->count= 0;
+  a->t0= t; a->ti0= ti;
+  a->sum= a->max= 0;
+  for(int k= 0; k< a->numHeap; ++k) { a->pos[a->heap[k]]= -1; }
+  a->numHeap= 0;
+  a->numCarried= a->numOpen;
+  a->sumSince= ((ProfTime) a->numOpen)* t;
+}
+/* efficiencies of the interval up to the elapsed time 't' and the ideal time
+ * 'ti' */
+static void PopAccEfficiencies(const PopAcc *const a, const ProfTime t, const ProfTime ti, double eff[5])
+{
+  const ProfTime sum= a->sum+ ((ProfTime) a->numOpen)* t- a->sumSince;
+  ProfTime max= a->max;
+  if(0< a->numCarried) { max= MAX(max, t- a->t0); }
+  if(0< a->numHeap) { max= MAX(max, PopAccKey(a, 0)+ t); }
+  const ProfTime T= t- a->t0, Ti= MAX(ti- a->ti0, max);
+  const double avg= ((double) sum)/ ((double) MAX(1, Pop.n));
+  eff[0]= 0< max? avg/ ((double) max): 1.0;
+  eff[1]= 0< T? ((double) max)/ ((double) T): 1.0;
+  eff[2]= 0< Ti? ((double) max)/ ((double) Ti): 1.0;
+  eff[3]= 0< T? ((double) Ti)/ ((double) T): 1.0;
+  eff[4]= eff[0]* eff[1];
+}
+static void PopAccWrite(const PopAcc *const a, const ProfTime t, const ProfTime ti)
+{
+  double eff[5];
+  PopAccEfficiencies(a, t, ti, eff);
+  if(a!= &Pop.acc) { ImpFprintSeconds(a->fp, a->t0); fputc(' ', a->fp); }
+  ImpFprintSeconds(a->fp, t);
+  fprintf(a->fp, " %.9lf %.9lf %.9lf %.9lf %.9lf\n", eff[0], eff[1], eff[2], eff[3], eff[4]);
+}
+/* pop.dat, and one file per extra window of the writer */
+inline static void PopInit()
+{
+  const int n= header.numThreads;
+  Pop.n= n;
+  Pop.since= (ProfTime *) calloc(MAX(1, n), sizeof(ProfTime));
+  Pop.state= (unsigned *) calloc(MAX(1, n), sizeof(unsigned));
+  PopAccInit(&Pop.acc, WindowPhases, 0);
+  Pop.acc.fp= fopen("pop.dat", "w");
+  if(NULL== Pop.acc.fp) { perror("pop.dat"); exit(0); }
+  fprintf(Pop.acc.fp, "#%14s %15s %15s %15s %15s %15s\n",
+          "t1-1", "LB-2", "CommE-3", "SerE-4", "TrE-5", "PE-6");
+
+  Pop.nw= MAX(0, Writer.nw- 1);
+  Pop.w= (PopAcc *) malloc(sizeof(PopAcc)* MAX(1, Pop.nw));
+  for(int i= 0; i< Pop.nw; ++i) {
+    const Window *const w= &Writer.w[i+ 1];
+    PopAcc *const a= &Pop.w[i];
+    PopAccInit(a, w->kind, w->size);
+    char fn[64]= { '\0' };
+    sprintf(fn, "pop.%c%lld%s.dat", "pet"[w->kind], w->size, WindowTime== w->kind? "ns": "");
+    a->fp= fopen(fn, "w");
+    if(NULL== a->fp) { perror(fn); exit(0); }
+    fprintf(a->fp, "#%14s %15s %15s %15s %15s %15s %15s\n",
+            "t0-1", "t1-2", "LB-3", "CommE-4", "SerE-5", "TrE-6", "PE-7");
+  }
+
+  for(int ip= 0; ip< header.numTasks; ++ip) {   /* masters useful from the start */
+    const int it= header.threadOff[ip];
+    Pop.state[it]= POP_MASTER;
+    PopAccOpen(&Pop.acc, it, 0);
+    for(int i= 0; i< Pop.nw; ++i) { PopAccOpen(&Pop.w[i], it, 0); }
+  }
+}
+inline static void PopClose(const int it, const ProfTime t)
+{
+  PopAccClose(&Pop.acc, it, t);
+  for(int i= 0; i< Pop.nw; ++i) { PopAccClose(&Pop.w[i], it, t); }
+}
+inline static void PopEvt(const int it, const ProfTime t, const long long type, const int e)
+{
+  if(0> it|| Pop.n<= it) { return; }
+  unsigned bit= POP_IN_MPI;
+  if(!ImpEventTypeIsMPI(type)) {
+    const int k= ImpOMPEventIndex(type);
+    if(0> k) { return; }
+    bit= 1u<< k;
+  }
+  const unsigned old= Pop.state[it];
+  const unsigned st= 0== e? old& ~bit: old| bit;
+  Pop.state[it]= st;
+
+  const bool was= PopIsUseful(old), is= PopIsUseful(st);
+  if(was&& !is) {
+    PopClose(it, t);
+  } else if(!was&& is) {
+    Pop.since[it]= t;
+    PopAccOpen(&Pop.acc, it, t);
+    for(int i= 0; i< Pop.nw; ++i) { PopAccOpen(&Pop.w[i], it, t); }
+  }
+}
+/* A window interval ends after 'size' useful phases, 'size' events, or at the
+ * first useful start 'size' ns after it began */
+inline static void PopWriteOut(const ProfTime tr, const ProfTime tc, const int e)
+{
+  for(int i= 0; i< Pop.nw; ++i) {
+    PopAcc *const a= &Pop.w[i];
+    if(WindowEvents== a->kind|| 0== e) { ++(a->count); }
+    const bool full= WindowTime== a->kind? 0== e&& tr- a->t0>= a->size: a->count>= a->size;
+    if(full) {
+      PopAccWrite(a, tr, tc);
+      PopAccReset(a, tr, tc);
+    }
+  }
   if(0!= e) { return; }         /* starting useful */
-  for(int i= 1; i< Writer.n; ++i) {
-    Writer.instant[i- 1][CRITIC]= Writer.instant[i][CRITIC];
-    Writer.instant[i- 1][ELAPSE]= Writer.instant[i][ELAPSE];
+  PopAccWrite(&Pop.acc, tr, tc);
+}
+/* Closes the open phases at the end and writes the per-thread useful time with
+ * its share of the runtime, and per rank the sum and the load balance of its
+ * threads */
+static void PopFinalize()
+{
+  const ProfTime T= Trace.tprog[PRV];
+  for(int it= 0; it< Pop.n; ++it) {
+    if(PopIsUseful(Pop.state[it])) { PopClose(it, MAX(T, Pop.since[it])); }
+  }
+  for(int i= 0; i< Pop.nw; ++i) {  /* the last, partial, interval */
+    if(Pop.w[i].t0< T) { PopAccWrite(&Pop.w[i], T, Trace.tprog[SIM]); }
   }
-  Writer.instant[Writer.n- 1][CRITIC]= tc;
-  Writer.instant[Writer.n- 1][ELAPSE]= tr;
 
-  Writer.cumulative[CRITIC]+= Writer.instant[Writer.n- 1][CRITIC]-
-    Writer.instant[Writer.n- 2][CRITIC];
-  Writer.cumulative[ELAPSE]+= Writer.instant[Writer.n- 1][ELAPSE]-
-    Writer.instant[Writer.n- 2][ELAPSE];
+  double eff[5];
+  PopAccWrite(&Pop.acc, T, Trace.tprog[SIM]);
+  PopAccEfficiencies(&Pop.acc, T, Trace.tprog[SIM], eff);
+  printf("Parallel-efficiency= %.6lf\n", eff[4]);
+  printf("  Load-balance= %.6lf\n", eff[0]);
+  printf("  Communication-efficiency= %.6lf\n", eff[1]);
+  printf("    Serialization-efficiency= %.6lf\n", eff[2]);
+  printf("    Transfer-efficiency= %.6lf\n", eff[3]);
 
-  fprintf(Writer.fp, "%.9e %.9e %.9e %.9e %.9e\n",
-          Writer.cumulative[ELAPSE],
-          Writer.instant[Writer.n- 1][CRITIC]- Writer.instant[0][CRITIC],
-          Writer.instant[Writer.n- 1][ELAPSE]- Writer.instant[0][ELAPSE],
-          Writer.cumulative[CRITIC], Writer.cumulative[ELAPSE]);
+  const ProfTime *const useful= Pop.acc.useful;
+  FILE *fp= fopen("threads.dat", "w");
+  fprintf(fp, "#%4s %6s %15s %15s %15s %15s\n",
+          "rank", "thread", "useful-3", "eff-4", "rank-useful-5", "rank-LB-6");
+  ProfTime maxRank= 0, sumRank= 0;
+  for(int ip= 0; ip< header.numTasks; ++ip) {
+    ProfTime sum= 0, max= 0;
+    for(int it= header.threadOff[ip]; it< header.threadOff[ip+ 1]; ++it) {
+      sum+= useful[it]; max= MAX(max, useful[it]);
+    }
+    const int nth= header.threadOff[ip+ 1]- header.threadOff[ip];
+    for(int it= header.threadOff[ip]; it< header.threadOff[ip+ 1]; ++it) {
+      fprintf(fp, "%5d %6d ", ip+ 1, it- header.threadOff[ip]+ 1);
+      ImpFprintSeconds(fp, useful[it]);
+      fprintf(fp, " %.9lf ", 0< T? ((double) useful[it])/ ((double) T): 1.0);
+      ImpFprintSeconds(fp, sum);
+      fprintf(fp, " %.9lf\n", 0< max? ((double) sum)/ ((double) nth)/ ((double) max): 1.0);
+    }
+    sumRank+= sum; maxRank= MAX(maxRank, sum);
+  }
+  fclose(fp); fp= NULL;
+  if(header.numThreads> header.numTasks) {
+    printf("  Load-balance (ranks)= %.6lf\n",
+           0< maxRank? ((double) sumRank)/ ((double) header.numTasks)/ ((double) maxRank): 1.0);
+  }
+
+  PopAccFree(&Pop.acc);
+  for(int i= 0; i< Pop.nw; ++i) { PopAccFree(&Pop.w[i]); }
+  FREE_IF(Pop.w); Pop.nw= 0;
+  FREE_IF(Pop.since); FREE_IF(Pop.state);
 }
-static void PlayEvt(const double t, const int e)
+static void PlayEvt(const ProfTime t, const int e)
 {
   if(e!= Trace.sim.e[Trace.sim.ievt]) {
     printf("Problem\n");
@@ -277,6 +819,7 @@ static void PlayEvt(const double t, const int e)
   }
 
   WriteOut(t, Trace.sim.t[Trace.sim.ievt], e);
+  PopWriteOut(t, Trace.sim.t[Trace.sim.ievt], e);
 
   SetLastPrvEvt(t, e);
   SetLastSimEvt(Trace.sim.t[Trace.sim.ievt], e);
@@ -290,9 +833,13 @@ static void PrvEvtPlayer(char *const line)
   
   char *ptr= ImpNthNum(line, 3);
   const int p= atoi(ptr)- 1;
-  if(Trace.monRank!= p) { return; }
-  ptr= ImpNthNum(ptr, 2);
-  Last.at= atof(ptr);
+  ptr= ImpNthNum(ptr, 1);
+  const int th= atoi(ptr)- 1;
+  const int it= ImpTimelineIndex(p, th);
+  const bool isMon= Trace.monRank== p&& Trace.monThread== th;
+  ptr= ImpNthNum(ptr, 1);
+  const ProfTime t= ImpAtoProfTime(ptr);
+  if(isMon) { Last.at= t; }
 
   ptr= strchr(ptr, ':');
   while(NULL!= ptr) {
@@ -305,7 +852,21 @@ static void PrvEvtPlayer(char *const line)
     case 50000003:  /* mpi other */
     case 50000004:  /* mpi rma */
     case 50000005:  /* mpi i/o */
-      PlayEvt(Last.at, atoi(ptr));
+      PopEvt(it, t, type, atoi(ptr));
+      if(isMon) { PlayEvt(t, atoi(ptr)); }
+      break;
+    case 60000001:  /* omp parallel */
+    case 60000002:  /* omp worksharing */
+    case 60000005:  /* omp barrier */
+    case 60000006:  /* omp unnamed critical */
+    case 60000007:  /* omp named critical */
+    case 60000016:  /* omp join */
+    case 60000018:  /* omp outlined function */
+    case 60000021:  /* omp task instantiation */
+    case 60000022:  /* omp taskwait */
+    case 60000023:  /* omp task function */
+    case 60000025:  /* omp taskgroup */
+      PopEvt(it, t, type, atoi(ptr));
       break;
     case 40000001:  /* application */
       break;
@@ -325,8 +886,10 @@ inline static void PrvPlay(FILE *const fp, const size_t nb, const int np)
 {
   Trace.sim.ievt= 0;
   WriteInit();
+  PopInit();
   ProcessFile(fp, nb, &PrvEvtPlayer);
   printf("prv-count: %ld, sim-count= %ld, diff= %ld\n", Trace.nevts, Trace.sim.nevts, Trace.nevts- Trace.sim.nevts);
+  PopFinalize();
   WriteFinalize();
 }
 
@@ -334,6 +897,7 @@ static void StoreSimulated()
 {
   FILE *fp= ImpFileReadExitOnError(Input.simfn);
   ImpProcessParaverHeader(fp);
+  Trace.tprog[SIM]= header.runTime;
 
   fpos_t hpos; fgetpos(fp, &hpos);
 
@@ -357,6 +921,7 @@ static void ProcessParaver()
 {
   FILE *fp= ImpFileReadExitOnError(Input.prvfn);
   ImpProcessParaverHeader(fp);
+  Trace.tprog[PRV]= header.runTime;
 
   const size_t numBytes= ImpGetNumBytes(fp);
 
@@ -366,20 +931,1167 @@ static void ProcessParaver()
 
   fclose(fp); fp= NULL;
 }
+/* filter: writes a reduced Paraver file with the selected record types,
+ * event types and ranks; selected ranks are renumbered contiguously */
+static struct {
+  ImpRangeList records;
+  ImpRangeList types;
+  ImpRangeList ranks;
+  int *newRank;                 /* 0-based old -> 1-based new, 0 if dropped */
+  int numTasks;
+  ImpOutBuf *out;
+  FILE *fp;
+} Filter= { { 0, NULL }, { 0, NULL }, { 0, NULL }, NULL, 0, NULL, NULL };
+
+inline static int FilterRank(const char *const p)
+{
+  const int t= atoi(p)- 1;
+  if(NULL== Filter.newRank) { return t+ 1; }
+  if(0> t|| Filter.numTasks<= t) { return 0; }
+  return Filter.newRank[t];
+}
+inline static void FilterAppendInt(ImpOutBuf *const ob, const int v)
+{
+  char a[16]; const int n= sprintf(a, "%d", v);
+  ImpOutBufAppend(ob, a, (size_t) n);
+}
+static void FilterLine(char *const line, ImpOutBuf *const ob)
+{
+  if('0'> line[0]|| '9'< line[0]) {
+    ImpOutBufAppend(ob, line, strlen(line)); ImpOutBufAppend(ob, "\n", 1);
+    return;
+  }
+  const int rt= atoi(line);
+  if(!ImpRangeListHas(&Filter.records, rt)) { return; }
+  if(1!= rt&& 2!= rt&& 3!= rt) {
+    ImpOutBufAppend(ob, line, strlen(line)); ImpOutBufAppend(ob, "\n", 1);
+    return;
+  }
+
+  const size_t start= ob->len;
+  char *task= ImpNthNum(line, 3);
+  const int r= FilterRank(task);
+  if(0== r) { return; }
+  ImpOutBufAppend(ob, line, (size_t) (task- line));
+  FilterAppendInt(ob, r);
+  char *ptr= strchr(task, ':');
+
+  if(3== rt) {
+    char *rtask= ImpNthNum(line, 9);
+    const int rr= FilterRank(rtask);
+    if(0== rr) { ob->len= start; return; }
+    ImpOutBufAppend(ob, ptr, (size_t) (rtask- ptr));
+    FilterAppendInt(ob, rr);
+    ptr= strchr(rtask, ':');
+  } else if(2== rt) {
+    char *pairs= ImpNthNum(ptr+ 1, 2);   /* past thread and time */
+    ImpOutBufAppend(ob, ptr, (size_t) (pairs- ptr));
+    bool kept= false;
+    ptr= pairs;
+    while(NULL!= ptr&& '\0'!= *ptr) {
+      const long long type= atoll(ptr);
+      char *val= strchr(ptr, ':');
+      if(NULL== val) { break; }
+      char *next= strchr(val+ 1, ':');
+      const size_t n= NULL== next? strlen(ptr): (size_t) (next- ptr);
+      if(ImpRangeListHas(&Filter.types, type)) {
+        if(kept) { ImpOutBufAppend(ob, ":", 1); }
+        ImpOutBufAppend(ob, ptr, n);
+        kept= true;
+      }
+      ptr= NULL== next? NULL: next+ 1;
+    }
+    if(!kept) { ob->len= start; return; }
+    ptr= NULL;
+  }
+  if(NULL!= ptr) { ImpOutBufAppend(ob, ptr, strlen(ptr)); }
+  ImpOutBufAppend(ob, "\n", 1);
+}
+static void FilterChunk(char *const chunk, const int tid, const size_t pos)
+{
+  (void) pos;
+  char *save= NULL;
+  char *line= strtok_r(chunk, "\n", &save);
+  while(NULL!= line) {
+    FilterLine(line, &Filter.out[tid]);
+    line= strtok_r(NULL, "\n", &save);
+  }
+}
+static void FilterFlush(const int tid)
+{
+  fwrite(Filter.out[tid].buf, 1, Filter.out[tid].len, Filter.fp);
+  Filter.out[tid].len= 0;
+}
+/* Copies the header, keeping only the selected tasks in the (single)
+ * application's task list and in the communicators */
+static void FilterHeader(FILE *const in, const fpos_t *const hpos)
+{
+#define MAX_HEADER_SIZE 131072  /* 128x1024 */
+  char *buf= (char *) malloc(sizeof(char)* MAX_HEADER_SIZE);
+  fsetpos(in, hpos);
+  if(NULL== fgets(buf, MAX_HEADER_SIZE, in)) {
+    printf("Problem reading header. Exiting.\n"); exit(0);
+  }
+  buf[strcspn(buf, "\n")]= '\0';
+
+  /* ...:nodes(cpus):nAppl:nTasks(nThreads:node,...),nComms */
+  char *nodes= strchr(buf, ')'); nodes= NULL== nodes? NULL: strchr(nodes+ 1, ')');
+  char *appl= NULL== nodes? NULL: nodes+ 2;
+  char *tasks= NULL== appl? NULL: strchr(appl, ':');
+  char *list= NULL== tasks? NULL: strchr(tasks, '(');
+  if(NULL== list|| 1!= atoi(appl)) {
+    printf("Cannot re-write the header of this trace; keeping all ranks.\n");
+    Filter.ranks.n= 0;
+  }
+  Filter.numTasks= NULL== list? 0: atoi(tasks+ 1);
+  Filter.newRank= NULL== list? NULL: (int *) malloc(sizeof(int)* MAX(1, Filter.numTasks));
+  int numKept= 0;
+  for(int i= 0; i< Filter.numTasks; ++i) {
+    Filter.newRank[i]= ImpRangeListHas(&Filter.ranks, i+ 1)? ++numKept: 0;
+  }
+
+  if(NULL== list) {
+    fprintf(Filter.fp, "%s\n", buf);
+  } else {
+    fprintf(Filter.fp, "%.*s%d(", (int) (tasks- buf+ 1), buf, numKept);
+    char *end= strchr(list, ')');
+    char *ptr= list+ 1;
+    bool first= true;
+    for(int i= 0; i< Filter.numTasks&& NULL!= ptr; ++i) {
+      char *next= strchr(ptr, ',');
+      if(NULL== next|| next> end) { next= end; }
+      if(0!= Filter.newRank[i]) {
+        fprintf(Filter.fp, "%s%.*s", first? "": ",", (int) (next- ptr), ptr);
+        first= false;
+      }
+      ptr= next== end? NULL: next+ 1;
+    }
+    fprintf(Filter.fp, "%s\n", end);
+  }
+
+  for(int i= 0; i< header.numComms; ++i) {
+    if(NULL== fgets(buf, MAX_HEADER_SIZE, in)) {
+      printf("Problem reading communicators. Exiting.\n"); exit(0);
+    }
+    buf[strcspn(buf, "\n")]= '\0';
+    /* c:appl:id:nTasks:t1:t2:... */
+    char *ptr= ImpNthNum(buf, 3);
+    if('c'!= buf[0]|| NULL== strchr(ptr, ':')) {
+      fprintf(Filter.fp, "%s\n", buf);
+      continue;
+    }
+    const int n= atoi(ptr);
+    int m= 0;
+    for(int j= 0; j< n; ++j) {
+      ptr= ImpNthNum(ptr, 1);
+      if(0!= FilterRank(ptr)) { ++m; }
+    }
+    ptr= ImpNthNum(buf, 3);
+    fprintf(Filter.fp, "%.*s%d", (int) (ptr- buf), buf, m);
+    for(int j= 0; j< n; ++j) {
+      ptr= ImpNthNum(ptr, 1);
+      const int r= FilterRank(ptr);
+      if(0!= r) { fprintf(Filter.fp, ":%d", r); }
+    }
+    fprintf(Filter.fp, "\n");
+  }
+  FREE_IF(buf);
+#undef MAX_HEADER_SIZE
+}
+static void FilterParaver()
+{
+  FILE *fp= ImpFileReadExitOnError(Input.prvfn);
+  fpos_t hpos; fgetpos(fp, &hpos);
+  ImpProcessParaverHeader(fp);
+
+  Filter.fp= fopen(Input.outfn, "w");
+  if(NULL== Filter.fp) { perror(Input.outfn); exit(0); }
+  ImpParseRangeList(Input.rectypes, &Filter.records);
+  ImpParseRangeList(Input.evttypes, &Filter.types);
+  ImpParseRangeList(Input.ranks, &Filter.ranks);
+  FilterHeader(fp, &hpos);
+
+  const size_t numBytes= ImpGetNumBytes(fp);
+  Filter.out= (ImpOutBuf *) malloc(sizeof(ImpOutBuf)* Input.numThreads);
+  memset(Filter.out, 0, sizeof(ImpOutBuf)* Input.numThreads);
+
+  ImpFreadTime= 0;
+  ProfTime tRead= GetTime();
+  ImpProcessParaverFileParallelWithNumBytes(fp, numBytes, Input.numThreads,
+                                            &FilterChunk, &FilterFlush);
+  tRead= GetTime()- tRead;
+  ImpPrintSpeed(0, numBytes, tRead, 1);
+
+  for(int i= 0; i< Input.numThreads; ++i) { FREE_IF(Filter.out[i].buf); }
+  FREE_IF(Filter.out); FREE_IF(Filter.newRank);
+  fclose(Filter.fp); Filter.fp= NULL;
+  fclose(fp); fp= NULL;
+}
+
+/* validate: fingerprints the MPI call sequence of every (rank, thread) in both
+ * traces with a rolling hash over the event ids, kept as a checkpoint every
+ * VALIDATE_STRIDE events.  Chunks are hashed in parallel, each into partial
+ * hashes per timeline, which compose as h= h_a* P^n_b+ h_b in file order.  The
+ * first diverging stride of each timeline is then rescanned to report the
+ * exact event. */
+#define VALIDATE_STRIDE 1024
+#define VALIDATE_PRIME 1099511628211ULL
+typedef struct _Fingerprint_type__ {
+  unsigned long long h;
+  ProfTime t;
+  long n;
+  long ncp;
+  long cap;
+  unsigned long long *cp;
+  ProfTime *tcp;
+  off_t *ocp;                   /* line of the checkpoint's event */
+  int *icp;                     /* and its index among the line's events */
+} Fingerprint;
+typedef struct _ValidateRec_type__ {
+  int it;
+  int c;                        /* events of the timeline so far in the chunk */
+  int inl;                      /* index among the timeline's events of the line */
+  unsigned long long h;         /* partial hash so far in the chunk */
+  ProfTime t;
+  off_t off;
+} ValidateRec;
+typedef struct _ValidateChunkState_type__ {
+  ValidateRec *rec;
+  long n;
+  long cap;
+  int *c;                       /* per timeline */
+  unsigned long long *h;        /* per timeline */
+} ValidateChunkState;
+static struct {
+  Fingerprint *fp[2];           /* prv, sim */
+  off_t body[2];                /* offset of the first record */
+  int np;
+  int cur;
+  long *diverge;                /* first differing checkpoint, -1 if none */
+  ValidateChunkState *chunk;
+} Validate= { { NULL, NULL }, { 0, 0 }, 0, 0, NULL, NULL };
+
+inline static unsigned long long ValidatePow(const long n)
+{
+  unsigned long long r= 1, b= VALIDATE_PRIME;
+  for(long e= n; 0< e; e>>= 1) {
+    if(e& 1) { r*= b; }
+    b*= b;
+  }
+  return r;
+}
+inline static void FingerprintCheckpoint(Fingerprint *const f, const off_t off, const int inl)
+{
+  if(f->ncp== f->cap) {
+    f->cap= 0== f->cap? 64: 2* f->cap;
+    f->cp= (unsigned long long *) realloc(f->cp, sizeof(unsigned long long)* f->cap);
+    f->tcp= (ProfTime *) realloc(f->tcp, sizeof(ProfTime)* f->cap);
+    f->ocp= (off_t *) realloc(f->ocp, sizeof(off_t)* f->cap);
+    f->icp= (int *) realloc(f->icp, sizeof(int)* f->cap);
+  }
+  f->cp[f->ncp]= f->h;
+  f->tcp[f->ncp]= f->t;
+  f->ocp[f->ncp]= off;
+  f->icp[f->ncp]= inl;
+  ++(f->ncp);
+}
+/* Calls 'fn' for every MPI event of a state record, with its index among the
+ * record's events of the same timeline; returns the timeline index, -1 for
+ * other records */
+static int ValidateLine(char *const line, void (*fn)(void *, const int, const ProfTime, const int, const int),
+                        void *arg)
+{
+  if(2!= atoi(line)) { return -1; }
+
+  char *ptr= ImpNthNum(line, 3);
+  const int p= atoi(ptr)- 1;
+  ptr= ImpNthNum(ptr, 1);
+  const int it= ImpTimelineIndex(p, atoi(ptr)- 1);
+  if(0> it|| Validate.np<= it) { return -1; }
+  ptr= ImpNthNum(ptr, 1);
+  const ProfTime t= ImpAtoProfTime(ptr);
+
+  int inl= 0;
+  ptr= strchr(ptr, ':');
+  while(NULL!= ptr) {
+    ++ptr;
+    long long type= atoll(ptr);
+    ptr= ImpNthNum(ptr, 1);
+    if(ImpEventTypeIsMPI(type)) {
+      fn(arg, it, t, atoi(ptr), inl++);
+    }
+    ptr= strchr(ptr, ':');
+  }
+  return it;
+}
+typedef struct _ValidateChunkArg_type__ {
+  ValidateChunkState *s;
+  off_t off;
+} ValidateChunkArg;
+static void ValidateChunkEvt(void *arg, const int it, const ProfTime t, const int e, const int inl)
+{
+  ValidateChunkArg *const a= (ValidateChunkArg *) arg;
+  ValidateChunkState *const s= a->s;
+  s->h[it]= s->h[it]* VALIDATE_PRIME+ (unsigned long long) (e+ 1);
+  ++(s->c[it]);
+  if(s->n== s->cap) {
+    s->cap= 0== s->cap? 4096: 2* s->cap;
+    s->rec= (ValidateRec *) realloc(s->rec, sizeof(ValidateRec)* s->cap);
+  }
+  ValidateRec *const r= &s->rec[s->n++];
+  r->it= it; r->c= s->c[it]; r->inl= inl; r->h= s->h[it]; r->t= t; r->off= a->off;
+}
+static void ValidateChunk(char *const chunk, const int tid, const size_t pos)
+{
+  ValidateChunkArg a= { &Validate.chunk[tid], 0 };
+  const off_t base= Validate.body[Validate.cur]+ (off_t) pos;
+  char *save= NULL;
+  char *line= strtok_r(chunk, "\n", &save);
+  while(NULL!= line) {
+    a.off= base+ (off_t) (line- chunk);
+    ValidateLine(line, &ValidateChunkEvt, &a);
+    line= strtok_r(NULL, "\n", &save);
+  }
+}
+/* Folds the chunk's partial hashes into the fingerprints, checkpointing the
+ * events that fall on a stride */
+static void ValidateFlush(const int tid)
+{
+  ValidateChunkState *const s= &Validate.chunk[tid];
+  for(long i= 0; i< s->n; ++i) {
+    const ValidateRec *const r= &s->rec[i];
+    Fingerprint *const f= &Validate.fp[Validate.cur][r->it];
+    if(0== (f->n+ r->c)% VALIDATE_STRIDE|| r->c== s->c[r->it]) {
+      const unsigned long long h= f->h;
+      f->h= h* ValidatePow(r->c)+ r->h;
+      f->t= r->t;
+      if(0== (f->n+ r->c)% VALIDATE_STRIDE) { FingerprintCheckpoint(f, r->off, r->inl); }
+      if(r->c== s->c[r->it]) {
+        f->n+= r->c;
+        s->c[r->it]= 0; s->h[r->it]= 0;
+      } else {
+        f->h= h;
+      }
+    }
+  }
+  s->n= 0;
+}
+static void ValidateFingerprintFile(const char *const fn, const int which)
+{
+  FILE *fp= ImpFileReadExitOnError(fn);
+  ImpProcessParaverHeader(fp);
+  const size_t numBytes= ImpGetNumBytes(fp);
+
+  if(0== which) {
+    Validate.np= header.numThreads;
+  } else if(Validate.np!= header.numThreads) {
+    printf("Number of threads differ: prv %d, sim %d\n", Validate.np, header.numThreads);
+  }
+  Validate.cur= which;
+  Validate.body[which]= ftello(fp);
+  Validate.fp[which]= (Fingerprint *) malloc(sizeof(Fingerprint)* Validate.np);
+  memset(Validate.fp[which], 0, sizeof(Fingerprint)* Validate.np);
+
+  const int nt= MAX(1, Input.numThreads);
+  Validate.chunk= (ValidateChunkState *) malloc(sizeof(ValidateChunkState)* nt);
+  memset(Validate.chunk, 0, sizeof(ValidateChunkState)* nt);
+  for(int i= 0; i< nt; ++i) {
+    Validate.chunk[i].c= (int *) calloc(MAX(1, Validate.np), sizeof(int));
+    Validate.chunk[i].h= (unsigned long long *) calloc(MAX(1, Validate.np), sizeof(unsigned long long));
+  }
+  ImpProcessParaverFileParallelWithNumBytes(fp, numBytes, nt, &ValidateChunk, &ValidateFlush);
+  for(int i= 0; i< nt; ++i) {
+    FREE_IF(Validate.chunk[i].rec); FREE_IF(Validate.chunk[i].c); FREE_IF(Validate.chunk[i].h);
+  }
+  FREE_IF(Validate.chunk);
+
+  for(int ip= 0; ip< Validate.np; ++ip) {
+    FingerprintCheckpoint(&Validate.fp[which][ip], 0, 0);  /* tail, also if empty */
+  }
+  fclose(fp); fp= NULL;
+}
+/* Rescan of the 'k'-th stride of timeline 'it', from the event of the
+ * previous checkpoint on */
+typedef struct _ValidateStride_type__ {
+  int it;
+  int skip;
+  int n;
+  int e[VALIDATE_STRIDE];
+  ProfTime t[VALIDATE_STRIDE];
+} ValidateStride;
+static void ValidateStrideEvt(void *arg, const int it, const ProfTime t, const int e, const int inl)
+{
+  (void) inl;
+  ValidateStride *const s= (ValidateStride *) arg;
+  if(it!= s->it|| VALIDATE_STRIDE== s->n) { return; }
+  if(0< s->skip) { --(s->skip); return; }
+  s->e[s->n]= e; s->t[s->n]= t;
+  ++(s->n);
+}
+static void ValidateRescan(const char *const fn, const int which, const int it, const long k,
+                           ValidateStride *const s)
+{
+  const Fingerprint *const f= &Validate.fp[which][it];
+  s->it= it; s->n= 0;
+  s->skip= 0< k? f->icp[k- 1]+ 1: 0;
+  FILE *fp= ImpFileReadExitOnError(fn);
+  fseeko(fp, 0< k? f->ocp[k- 1]: Validate.body[which], SEEK_SET);
+#define MAX_LINE_SIZE 1048576  /* 1024x1024 */
+  char *line= (char *) malloc(sizeof(char)* MAX_LINE_SIZE);
+  while(VALIDATE_STRIDE> s->n&& NULL!= fgets(line, MAX_LINE_SIZE, fp)) {
+    ValidateLine(line, &ValidateStrideEvt, s);
+  }
+#undef MAX_LINE_SIZE
+  FREE_IF(line);
+  fclose(fp); fp= NULL;
+}
+typedef struct _ValidateWork_type__ {
+  pthread_t th;
+  bool started;
+  int first;
+  int last;
+} ValidateWork;
+static void *ValidateCompareRanks(void *arg)
+{
+  const ValidateWork *const w= (const ValidateWork *) arg;
+  for(int ip= w->first; ip< w->last; ++ip) {
+    const Fingerprint *const a= &Validate.fp[0][ip];
+    const Fingerprint *const b= &Validate.fp[1][ip];
+    const long n= MIN(a->ncp, b->ncp);
+    long k= 0;
+    while(k< n&& a->cp[k]== b->cp[k]) { ++k; }
+    Validate.diverge[ip]= k== n&& a->n== b->n? -1: k;
+  }
+  return NULL;
+}
+static void ValidateTraces()
+{
+  ValidateFingerprintFile(Input.prvfn, 0);
+  ValidateFingerprintFile(Input.simfn, 1);
+
+  const int np= Validate.np;
+  const int nt= MAX(1, MIN(Input.numThreads, np));
+  Validate.diverge= (long *) malloc(sizeof(long)* MAX(1, np));
+  ValidateWork *w= (ValidateWork *) malloc(sizeof(ValidateWork)* nt);
+  for(int i= 0; i< nt; ++i) {
+    w[i].first= (int) (((long) np)* i/ nt);
+    w[i].last= (int) (((long) np)* (i+ 1)/ nt);
+    pthread_attr_t attr; pthread_attr_init(&attr);
+    ImpSetParserAffinity(&attr, i);
+    w[i].started= 0== pthread_create(&w[i].th, &attr, &ValidateCompareRanks, &w[i]);
+    if(!w[i].started) { ValidateCompareRanks(&w[i]); }  /* on this thread then */
+    pthread_attr_destroy(&attr);
+  }
+  for(int i= 0; i< nt; ++i) {
+    if(w[i].started) { pthread_join(w[i].th, NULL); }
+  }
+  FREE_IF(w);
+
+  int numDiverged= 0;
+  ValidateStride *s[2]= { (ValidateStride *) malloc(sizeof(ValidateStride)),
+                          (ValidateStride *) malloc(sizeof(ValidateStride)) };
+  for(int ip= 0; ip< np; ++ip) {
+    const Fingerprint *const a= &Validate.fp[0][ip];
+    const Fingerprint *const b= &Validate.fp[1][ip];
+    const long k= Validate.diverge[ip];
+    if(-1== k) { continue; }
+    ++numDiverged;
+    ValidateRescan(Input.prvfn, 0, ip, k, s[0]);
+    ValidateRescan(Input.simfn, 1, ip, k, s[1]);
+    int d= 0;
+    while(d< s[0]->n&& d< s[1]->n&& s[0]->e[d]== s[1]->e[d]) { ++d; }
+
+    const int task= ImpTimelineTask(ip);
+    printf("rank %d thread %d: diverges at event %ld (prv-count: %ld, sim-count: %ld)",
+           task+ 1, ip- header.threadOff[task]+ 1, k* VALIDATE_STRIDE+ d, a->n, b->n);
+    for(int which= 0; which< 2; ++which) {
+      printf(", %s ", 0== which? "prv": "sim");
+      if(d< s[which]->n) {
+        const int e= s[which]->e[d];
+        printf("%s at ", 0< e&& NUM_MPI_FUNCS> e? MPINames[e]: "useful");
+        ImpFprintSeconds(stdout, s[which]->t[d]);
+        printf(" s");
+      } else {
+        printf("ends");
+      }
+    }
+    printf("\n");
+  }
+  FREE_IF(s[0]); FREE_IF(s[1]);
+  printf("Validated %d threads of %d ranks: %d match, %d diverge\n",
+         np, header.numTasks, np- numDiverged, numDiverged);
+
+  for(int which= 0; which< 2; ++which) {
+    for(int ip= 0; ip< np; ++ip) {
+      FREE_IF(Validate.fp[which][ip].cp); FREE_IF(Validate.fp[which][ip].tcp);
+      FREE_IF(Validate.fp[which][ip].ocp); FREE_IF(Validate.fp[which][ip].icp);
+    }
+    FREE_IF(Validate.fp[which]);
+  }
+  FREE_IF(Validate.diverge);
+}
+
+/* sample: estimates the transfer efficiency from a subset of newline-aligned
+ * blocks.  Each prv block is aligned with the sim block at the same time
+ * scaled by the ratio of the runtimes; as both traces carry the same MPI call
+ * sequence, the ratio of their MPI event rates (all ranks) estimates the local
+ * transfer efficiency, ideal over recorded time. */
+static struct {
+  long n;
+  ProfTime t[2];                /* first and last time-stamp */
+} Sample= { 0, { ProfTimeInvalid, ProfTimeInvalid } };
+static void SampleEvtCounter(char *const line)
+{
+  if(2!= atoi(line)) { return; }
+
+  char *ptr= ImpNthNum(line, 5);
+  const ProfTime t= ImpAtoProfTime(ptr);
+
+  ptr= strchr(ptr, ':');
+  while(NULL!= ptr) {
+    ++ptr;
+    long long type= atoll(ptr);
+    ptr= ImpNthNum(ptr, 1);
+    if(ImpEventTypeIsMPI(type)) {
+      if(0== Sample.n) { Sample.t[0]= t; }
+      Sample.t[1]= t;
+      ++(Sample.n);
+    }
+    ptr= strchr(ptr, ':');
+  }
+}
+typedef struct _SampleFile_type__ {
+  FILE *fp;
+  off_t body;                   /* first byte after the header */
+  off_t end;
+  ProfTime runTime;
+} SampleFile;
+static void SampleOpen(SampleFile *const f, const char *const fn)
+{
+  f->fp= ImpFileReadExitOnError(fn);
+  ImpProcessParaverHeader(f->fp);
+  f->runTime= header.runTime;
+  f->body= ftello(f->fp);
+  fseeko(f->fp, 0, SEEK_END);
+  f->end= ftello(f->fp);
+}
+/* Reads up to 'len' bytes at 'pos' and returns the part from the first line
+ * starting at or after 'pos' to the last complete line, NULL if none; the
+ * byte before 'pos' is read as well to tell whether a line starts at 'pos' */
+static char *SampleBlock(const SampleFile *const f, off_t pos, const size_t len, char *const buf)
+{
+  pos= MAX(pos, f->body)- 1;
+  fseeko(f->fp, pos, SEEK_SET);
+  const size_t n= TimedFread(buf, 1, len, f->fp);
+  if(0== n) { return NULL; }
+  buf[n]= '\0';
+  char *start= strchr(buf, '\n');
+  if(NULL== start) { return NULL; }
+  ++start;
+  const size_t last= pos+ (off_t) n< f->end? ImpGetLastNewlinePos(buf, len, n): n;
+  if(ULLONG_MAX== last|| buf+ last< start) { return NULL; }
+  buf[last]= '\0';
+  return start;
+}
+static ProfTime SampleTimeAt(const SampleFile *const f, const off_t pos, char *const buf)
+{
+#define PROBE_SIZE 65536
+  char *ptr= SampleBlock(f, pos, PROBE_SIZE, buf);
+  while(NULL!= ptr&& '\0'!= *ptr) {
+    if('0'<= ptr[0]&& '9'>= ptr[0]) {
+      return ImpAtoProfTime(ImpNthNum(ptr, 5));
+    }
+    ptr= strchr(ptr, '\n');
+    if(NULL!= ptr) { ++ptr; }
+  }
+#undef PROBE_SIZE
+  return PROFTIME_MAX;
+}
+/* Offset of the first probe whose first time-stamp is not before 't' */
+static off_t SampleSeekTime(const SampleFile *const f, const ProfTime t, const size_t step, char *const buf)
+{
+  off_t lo= f->body, hi= f->end;
+  while(hi- lo> (off_t) step) {
+    const off_t mid= lo+ (hi- lo)/ 2;
+    if(SampleTimeAt(f, mid, buf)< t) { lo= mid; } else { hi= mid; }
+  }
+  return lo;
+}
+static bool SampleCount(const SampleFile *const f, const off_t pos, const size_t len, char *const buf)
+{
+  char *ptr= SampleBlock(f, pos, len, buf);
+  if(NULL== ptr) { return false; }
+  Sample.n= 0;
+  ImpProcessBuffer(ptr);
+  return 1< Sample.n&& Sample.t[1]> Sample.t[0];
+}
+static void SampleTraces()
+{
+  SampleFile prv, sim;
+  SampleOpen(&prv, Input.prvfn);
+  SampleOpen(&sim, Input.simfn);
+
+  const int k= MAX(1, Input.sampleBlocks);
+  const size_t len= MAX(Input.sampleSize, 65536);
+  const off_t numBytes= prv.end- prv.body;
+  char *buf= (char *) malloc(sizeof(char)* (len+ 1));
+  ImpSetLineProcessorAndResetFreadTime(&SampleEvtCounter);
+
+  ProfTime tRead= GetTime();
+  double sum= 0.0, sum2= 0.0;
+  int m= 0;
+  unsigned seed= Input.sampleSeed;
+  for(int i= 0; i< k; ++i) {
+    const double f= Input.sampleRandom? ((double) rand_r(&seed))/ ((double) RAND_MAX):
+      (i+ 0.5)/ k;
+    const off_t pos= prv.body+ (off_t) (f* (double) MAX(0, numBytes- (off_t) len));
+    if(!SampleCount(&prv, pos, len, buf)) { continue; }
+    const double ratep= ((double) Sample.n)/ ((double) (Sample.t[1]- Sample.t[0]));
+
+    const ProfTime ts= (ProfTime) (((double) Sample.t[0])* ((double) sim.runTime)/ ((double) prv.runTime));
+    const off_t spos= SampleSeekTime(&sim, ts, len/ 4, buf);
+    if(!SampleCount(&sim, spos, len, buf)) { continue; }
+    const double rates= ((double) Sample.n)/ ((double) (Sample.t[1]- Sample.t[0]));
+
+    const double e= ratep/ rates;
+    sum+= e; sum2+= e* e; ++m;
+  }
+  tRead= GetTime()- tRead;
+
+  printf("Runtime ratio (sim/prv): %.6lf\n", ((double) sim.runTime)/ ((double) prv.runTime));
+  if(0== m) {
+    printf("No usable sample block.\n");
+  } else {
+    const double mean= sum/ m;
+    const double var= 1< m? MAX(0.0, (sum2- m* mean* mean)/ (m- 1)): 0.0;
+    printf("Tr.Eff. estimate: %.6lf +- %.6lf (95%% CI, %d of %d blocks of %.1lf MB)\n",
+           mean, 1.96* sqrt(var/ m), m, k, ((double) len)/ 1024.0/ 1024.0);
+  }
+  ImpPrintSpeed(0, (size_t) m* 2* len, tRead, 1);
+
+  FREE_IF(buf);
+  fclose(sim.fp); sim.fp= NULL;
+  fclose(prv.fp); prv.fp= NULL;
+}
+
+/* serve: keeps the MPI event timelines of all ranks of both traces in memory
+ * and answers queries on a local Unix socket.  Every trace is one array with
+ * per-timeline offsets, a timeline being a (rank, thread).
+ *
+ * Requests are text lines, replies are little-endian int64 values: a count
+ * followed by as many records, or -1 on error.  Times are in ns, ranks and
+ * threads 1-based, 't1' -1 means the end and 'window' is, e.g., p10, e500 or
+ * t1000000.
+ *   info                           -> 1 record: ranks, timelines, prv-runtime,
+ *                                     sim-runtime
+ *   monitor <rank> [<thread>] <t0> <t1> <window>
+ *                                  -> records of the resolved.dat columns, of
+ *                                     the first thread by default
+ *   aggregate <t0> <t1>            -> per timeline: rank, thread, critical,
+ *                                     elapsed
+ *   quit                           -> stops the server, closing all clients */
+typedef struct _Timeline_type__ {
+  int np;                       /* timelines */
+  int numTasks;
+  int *threadOff;               /* numTasks+ 1 */
+  long *off;                    /* np+ 1 */
+  long *fill;
+  ProfTime *t;
+  int *e;
+  ProfTime runTime;
+} Timeline;
+static Timeline *TimelineCur= NULL;
+static void TimelineEvtCounter(char *const line)
+{
+  if(2!= atoi(line)) { return; }
+
+  char *ptr= ImpNthNum(line, 3);
+  const int task= atoi(ptr)- 1;
+  ptr= ImpNthNum(ptr, 1);
+  const int p= ImpTimelineIndex(task, atoi(ptr)- 1);
+  if(0> p|| TimelineCur->np<= p) { return; }
+  ptr= ImpNthNum(ptr, 1);
+
+  ptr= strchr(ptr, ':');
+  while(NULL!= ptr) {
+    ++ptr;
+    long long type= atoll(ptr);
+    ptr= ImpNthNum(ptr, 1);
+    if(ImpEventTypeIsMPI(type)) { ++(TimelineCur->off[p+ 1]); }
+    ptr= strchr(ptr, ':');
+  }
+}
+static void TimelineEvtReader(char *const line)
+{
+  if(2!= atoi(line)) { return; }
+
+  char *ptr= ImpNthNum(line, 3);
+  const int task= atoi(ptr)- 1;
+  ptr= ImpNthNum(ptr, 1);
+  const int p= ImpTimelineIndex(task, atoi(ptr)- 1);
+  if(0> p|| TimelineCur->np<= p) { return; }
+  ptr= ImpNthNum(ptr, 1);
+  const ProfTime t= ImpAtoProfTime(ptr);
+
+  ptr= strchr(ptr, ':');
+  while(NULL!= ptr) {
+    ++ptr;
+    long long type= atoll(ptr);
+    ptr= ImpNthNum(ptr, 1);
+    if(ImpEventTypeIsMPI(type)) {
+      const long i= (TimelineCur->fill[p])++;
+      TimelineCur->t[i]= t;
+      TimelineCur->e[i]= atoi(ptr);
+    }
+    ptr= strchr(ptr, ':');
+  }
+}
+static void TimelineLoad(Timeline *const tl, const char *const fn)
+{
+  FILE *fp= ImpFileReadExitOnError(fn);
+  ImpProcessParaverHeader(fp);
+  fpos_t hpos; fgetpos(fp, &hpos);
+  const size_t numBytes= ImpGetNumBytes(fp);
+
+  tl->np= header.numThreads;
+  tl->numTasks= header.numTasks;
+  tl->threadOff= (int *) malloc(sizeof(int)* (tl->numTasks+ 1));
+  memcpy(tl->threadOff, header.threadOff, sizeof(int)* (tl->numTasks+ 1));
+  tl->runTime= header.runTime;
+  tl->off= (long *) malloc(sizeof(long)* (tl->np+ 1));
+  memset(tl->off, 0, sizeof(long)* (tl->np+ 1));
+  TimelineCur= tl;
+
+  fsetpos(fp, &hpos);
+  ProcessFile(fp, numBytes, &TimelineEvtCounter);
+  for(int ip= 0; ip< tl->np; ++ip) { tl->off[ip+ 1]+= tl->off[ip]; }
+
+  const long n= tl->off[tl->np];
+  tl->t= (ProfTime *) malloc(sizeof(ProfTime)* MAX(1, n));
+  tl->e= (int *) malloc(sizeof(int)* MAX(1, n));
+  memset(tl->t, 0, sizeof(ProfTime)* MAX(1, n));
+  memset(tl->e, 0, sizeof(int)* MAX(1, n));
+  tl->fill= (long *) malloc(sizeof(long)* MAX(1, tl->np));
+  memcpy(tl->fill, tl->off, sizeof(long)* tl->np);
+
+  fsetpos(fp, &hpos);
+  ProcessFile(fp, numBytes, &TimelineEvtReader);
+  TimelineCur= NULL;
+  FREE_IF(tl->fill);
+  fclose(fp); fp= NULL;
+}
+static void TimelineFree(Timeline *const tl)
+{
+  FREE_IF(tl->threadOff); FREE_IF(tl->off); FREE_IF(tl->t); FREE_IF(tl->e);
+}
+
+/* Every client is served on its own thread with its own reply buffer; the
+ * timelines are only read once loaded */
+typedef struct _ServeClient_type__ {
+  pthread_t th;
+  int fd;
+  bool done;
+  ImpOutBuf out;
+  struct _ServeClient_type__ *next;
+} ServeClient;
+static struct {
+  Timeline prv;
+  Timeline sim;
+  long *matched;                /* per rank */
+  int sfd;
+  bool serving;
+  ServeClient *clients;
+  pthread_mutex_t lock;         /* of serving and clients */
+} Server= { .sfd= -1, .serving= true, .clients= NULL, .lock= PTHREAD_MUTEX_INITIALIZER };
+inline static void ServeAppend(ImpOutBuf *const out, const long long v)
+{
+  ImpOutBufAppend(out, (const char *) &v, sizeof(v));
+}
+/* Number of matched events of timeline 'ip', counting until the first mismatch */
+static long ServeCountMatched(const int ip)
+{
+  const long np= Server.prv.off[ip+ 1]- Server.prv.off[ip];
+  const long ns= Server.sim.off[ip+ 1]- Server.sim.off[ip];
+  const int *const ep= Server.prv.e+ Server.prv.off[ip];
+  const int *const es= Server.sim.e+ Server.sim.off[ip];
+  long n= MIN(np, ns), i= 0;
+  while(i< n&& ep[i]== es[i]) { ++i; }
+  return i;
+}
+inline static long ServeNumMatched(const int ip)
+{
+  return Server.matched[ip];
+}
+/* First of the 'n' sorted times 't' after 'v', or at or after it if !after */
+static long ServeSearch(const ProfTime *const t, const long n, const ProfTime v, const bool after)
+{
+  long lo= 0, hi= n;
+  while(lo< hi) {
+    const long mid= lo+ (hi- lo)/ 2;
+    if(t[mid]< v|| (after&& t[mid]== v)) { lo= mid+ 1; } else { hi= mid; }
+  }
+  return lo;
+}
+static bool ServeMonitor(ImpOutBuf *const out, const int task, const int thread, const ProfTime t0,
+                         const ProfTime t1, const char *const spec)
+{
+  const int ip= ImpTimelineIndex(task, thread);
+  if(0> ip) { return false; }
+  const char *const kinds= "pet";
+  const char *const k= '\0'== spec[0]? NULL: strchr(kinds, spec[0]);
+  if(NULL== k|| 0>= atoll(spec+ 1)) { return false; }
+  const ProfTime *const tp= Server.prv.t+ Server.prv.off[ip];
+  const ProfTime *const ts= Server.sim.t+ Server.sim.off[ip];
+  const int *const e= Server.prv.e+ Server.prv.off[ip];
+  const long n= ServeNumMatched(ip);
+
+  /* a fixed window never holds more than the timeline's events and the initial
+   * zero, so larger ones give the same rows */
+  const WindowKind kind= (WindowKind) (k- kinds);
+  const ProfTime size= WindowTime== kind? atoll(spec+ 1): MIN(atoll(spec+ 1), n+ 1);
+  Window w;
+  if(!WindowInit(&w, kind, size)) { return false; }
+
+  ServeAppend(out, 0);          /* count, set below */
+  long long numRows= 0;
+  ProfTime row[5];
+  for(long i= 0; i< n; ++i) {
+    if(0<= t1&& t1< tp[i]) { break; }
+    if(!WindowStep(&w, tp[i], ts[i], e[i], row)|| tp[i]< t0) { continue; }
+    for(int j= 0; j< 5; ++j) { ServeAppend(out, row[j]); }
+    ++numRows;
+  }
+  memcpy(out->buf, &numRows, sizeof(numRows));
+  FREE_IF(w.ring);
+  return true;
+}
+static void ServeAggregate(ImpOutBuf *const out, const ProfTime t0, const ProfTime t1)
+{
+  const int np= Server.prv.np;
+  ServeAppend(out, np);
+  for(int ip= 0; ip< np; ++ip) {
+    const ProfTime *const tp= Server.prv.t+ Server.prv.off[ip];
+    const ProfTime *const ts= Server.sim.t+ Server.sim.off[ip];
+    const long n= ServeNumMatched(ip);
+    const long a= ServeSearch(tp, n, t0, false);
+    const long b= 0> t1? n: ServeSearch(tp, n, t1, true);
+    const int task= ImpTimelineTask(ip);
+    ServeAppend(out, task+ 1);
+    ServeAppend(out, ip- header.threadOff[task]+ 1);
+    ServeAppend(out, b> a? ts[b- 1]- ts[a]: 0);
+    ServeAppend(out, b> a? tp[b- 1]- tp[a]: 0);
+  }
+}
+/* Handles one request line; false to stop serving */
+static bool ServeRequest(char *const line, ImpOutBuf *const out)
+{
+  char cmd[16]= { '\0' }, spec[32]= { '\0' };
+  long long a= 0, b= 0, c= 0, d= 0;
+  out->len= 0;
+  if(1!= sscanf(line, "%15s", cmd)) { return true; }
+
+  bool ok= true;
+  if(0== strcmp("quit", cmd)) {
+    return false;
+  } else if(0== strcmp("info", cmd)) {
+    ServeAppend(out, 1);
+    ServeAppend(out, Server.prv.numTasks); ServeAppend(out, Server.prv.np);
+    ServeAppend(out, Server.prv.runTime); ServeAppend(out, Server.sim.runTime);
+  } else if(0== strcmp("monitor", cmd)&& 5== sscanf(line, "%*s %lld %lld %lld %lld %31s", &a, &b, &c, &d, spec)) {
+    ok= ServeMonitor(out, (int) a- 1, (int) b- 1, c, d, spec);
+  } else if(0== strcmp("monitor", cmd)&& 4== sscanf(line, "%*s %lld %lld %lld %31s", &a, &b, &c, spec)) {
+    ok= ServeMonitor(out, (int) a- 1, 0, b, c, spec);
+  } else if(0== strcmp("aggregate", cmd)&& 2== sscanf(line, "%*s %lld %lld", &a, &b)) {
+    ServeAggregate(out, a, b);
+  } else {
+    ok= false;
+  }
+  if(!ok) { out->len= 0; ServeAppend(out, -1); }
+  return true;
+}
+/* Answers the requests of a client until it closes, or until 'quit', which
+ * also stops accepting */
+static void *ServeClientWork(void *arg)
+{
+  ServeClient *const c= (ServeClient *) arg;
+  FILE *cfp= fdopen(dup(c->fd), "r");  /* the socket is closed with c->fd */
+  char line[256]= { '\0' };
+  bool connected= NULL!= cfp;
+  while(connected&& NULL!= fgets(line, sizeof(line), cfp)) {
+    ProfTime t= GetTime();
+    if(!ServeRequest(line, &c->out)) {
+      pthread_mutex_lock(&Server.lock);
+      Server.serving= false;
+      shutdown(Server.sfd, SHUT_RDWR);  /* wakes up accept */
+      pthread_mutex_unlock(&Server.lock);
+      c->out.len= 0;
+      connected= false;
+    }
+    /* a client gone before reading its reply (EPIPE) only ends that client */
+    for(size_t done= 0; done< c->out.len; ) {
+      const ssize_t n= send(c->fd, c->out.buf+ done, c->out.len- done, MSG_NOSIGNAL);
+      if(0> n&& EINTR== errno) { continue; }
+      if(0>= n) { connected= false; break; }
+      done+= (size_t) n;
+    }
+    t= GetTime()- t;
+    line[strcspn(line, "\n")]= '\0';
+    printf("\"%s\": %zu B in %.3lf ms\n", line, c->out.len, ((double) t)* 1.0e-6); fflush(stdout);
+  }
+  if(NULL!= cfp) { fclose(cfp); cfp= NULL; }
+  pthread_mutex_lock(&Server.lock);
+  c->done= true;
+  pthread_mutex_unlock(&Server.lock);
+  return NULL;
+}
+/* Joins the clients that are done, or all of them after shutting them down */
+static void ServeReapClients(const bool all)
+{
+  pthread_mutex_lock(&Server.lock);
+  ServeClient **pc= &Server.clients;
+  while(NULL!= *pc) {
+    ServeClient *const c= *pc;
+    if(!all&& !c->done) { pc= &c->next; continue; }
+    *pc= c->next;
+    pthread_mutex_unlock(&Server.lock);
+    if(all) { shutdown(c->fd, SHUT_RDWR); }
+    pthread_join(c->th, NULL);
+    close(c->fd);
+    FREE_IF(c->out.buf);
+    free(c);
+    pthread_mutex_lock(&Server.lock);
+  }
+  pthread_mutex_unlock(&Server.lock);
+}
+static void ServeTraces()
+{
+  TimelineLoad(&Server.prv, Input.prvfn);
+  TimelineLoad(&Server.sim, Input.simfn);
+  /* timelines are indexed with the header of the sim trace from here on */
+  if(Server.prv.numTasks!= Server.sim.numTasks||
+     0!= memcmp(Server.prv.threadOff, Server.sim.threadOff, sizeof(int)* (Server.prv.numTasks+ 1))) {
+    printf("Ranks or threads differ: prv %d/%d, sim %d/%d\n",
+           Server.prv.numTasks, Server.prv.np, Server.sim.numTasks, Server.sim.np);
+    exit(0);
+  }
+  const int np= Server.prv.np;
+  Server.matched= (long *) malloc(sizeof(long)* MAX(1, np));
+  for(int ip= 0; ip< np; ++ip) { Server.matched[ip]= ServeCountMatched(ip); }
+
+  const char *const fn= NULL== Input.socketfn? "ideal2resolved.sock": Input.socketfn;
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family= AF_UNIX;
+  strncpy(addr.sun_path, fn, sizeof(addr.sun_path)- 1);
+  /* only a stale socket is replaced: neither another file, nor the socket of
+   * a running server */
+  struct stat st;
+  if(0== lstat(fn, &st)) {
+    if(!S_ISSOCK(st.st_mode)) {
+      printf("\"%s\" exists and is not a socket\n", fn);
+      exit(0);
+    }
+    const int tfd= socket(AF_UNIX, SOCK_STREAM, 0);
+    const bool live= 0<= tfd&& 0== connect(tfd, (struct sockaddr *) &addr, sizeof(addr));
+    if(0<= tfd) { close(tfd); }
+    if(live) {
+      printf("A server is already running on \"%s\"\n", fn);
+      exit(0);
+    }
+    unlink(fn);
+  }
+  const int sfd= socket(AF_UNIX, SOCK_STREAM, 0);
+  if(0> sfd|| 0!= bind(sfd, (struct sockaddr *) &addr, sizeof(addr))|| 0!= listen(sfd, 8)) {
+    perror(fn); exit(0);
+  }
+  printf("Serving on \"%s\"\n", fn); fflush(stdout);
+
+  Server.sfd= sfd;
+  for(;;) {
+    const int cfd= accept(sfd, NULL, NULL);
+    ServeReapClients(false);
+    pthread_mutex_lock(&Server.lock);
+    const bool serving= Server.serving;
+    pthread_mutex_unlock(&Server.lock);
+    if(!serving) {
+      if(0<= cfd) { close(cfd); }
+      break;
+    }
+    if(0> cfd) { continue; }
+    ServeClient *const c= (ServeClient *) malloc(sizeof(ServeClient));
+    memset(c, 0, sizeof(ServeClient));
+    c->fd= cfd;
+    if(0!= pthread_create(&c->th, NULL, &ServeClientWork, c)) {
+      perror("pthread_create");
+      close(cfd);
+      free(c);
+      continue;
+    }
+    pthread_mutex_lock(&Server.lock);
+    c->next= Server.clients; Server.clients= c;
+    pthread_mutex_unlock(&Server.lock);
+  }
+  ServeReapClients(true);
+  close(sfd);
+  unlink(fn);
+  FREE_IF(Server.matched);
+  TimelineFree(&Server.sim);
+  TimelineFree(&Server.prv);
+}
+
+/* check: runs the analysis, then compares every file of 'golden-dir' with the
+ * output of the same name, numerically within 'golden-tol' (relative, or
+ * absolute below 1), and checks every pass against the minimum speed
+ * 'budget-speed' [MBps] and the maximum peak memory during it 'budget-rss'
+ * [MB]; both are lists with one value per pass, the last repeated for further
+ * passes.
+ * Returns the number of failures. */
+static int CheckCompare(const char *const gfn, const char *const fn)
+{
+  FILE *gfp= fopen(gfn, "r"), *fp= fopen(fn, "r");
+  if(NULL== gfp|| NULL== fp) {
+    printf("FAIL %s: cannot open (golden \"%s\")\n", fn, gfn);
+    if(gfp) { fclose(gfp); }
+    if(fp) { fclose(fp); }
+    return 1;
+  }
+  char gline[1024], line[1024];
+  int ln= 0, numFailed= 0;
+  while(0== numFailed) {
+    char *g= fgets(gline, sizeof(gline), gfp), *o= fgets(line, sizeof(line), fp);
+    ++ln;
+    if(NULL== g|| NULL== o) {
+      if(g!= o) {
+        printf("FAIL %s: %s at line %d\n", fn, NULL== o? "fewer lines": "more lines", ln);
+        ++numFailed;
+      }
+      break;
+    }
+    if('#'== gline[0]) { continue; }
+    char *gs= NULL, *os= NULL;
+    char *gt= strtok_r(gline, " \t\n", &gs), *ot= strtok_r(line, " \t\n", &os);
+    for(int col= 1; NULL!= gt|| NULL!= ot; ++col) {
+      if(NULL== gt|| NULL== ot) {
+        printf("FAIL %s: number of columns at line %d\n", fn, ln);
+        ++numFailed;
+        break;
+      }
+      char *ge= NULL, *oe= NULL;
+      const double a= strtod(gt, &ge), b= strtod(ot, &oe);
+      const bool ok= '\0'== *ge&& '\0'== *oe?
+        fabs(a- b)<= Input.goldenTol* MAX(1.0, fabs(a)): 0== strcmp(gt, ot);
+      if(!ok) {
+        printf("FAIL %s: line %d column %d: %s, golden %s\n", fn, ln, col, ot, gt);
+        ++numFailed;
+        break;
+      }
+      gt= strtok_r(NULL, " \t\n", &gs); ot= strtok_r(NULL, " \t\n", &os);
+    }
+  }
+  if(0== numFailed) { printf("ok   %s\n", fn); }
+  fclose(fp); fp= NULL;
+  fclose(gfp); gfp= NULL;
+  return numFailed;
+}
+static double CheckBudget(const char *const list, const int pass)
+{
+  if(NULL== list) { return 0.0; }
+  double v= 0.0;
+  const char *ptr= list;
+  for(int i= 0; i<= pass&& '\0'!= *ptr; ++i) {
+    char *end= NULL;
+    v= strtod(ptr, &end);
+    ptr= ','== *end? end+ 1: end;
+  }
+  return v;
+}
+static int CheckResults()
+{
+  int numFailed= 0;
+  if(NULL!= Input.goldenDir) {
+    DIR *d= opendir(Input.goldenDir);
+    if(NULL== d) { perror(Input.goldenDir); return 1; }
+    struct dirent *de= NULL;
+    while(NULL!= (de= readdir(d))) {
+      if('.'== de->d_name[0]) { continue; }
+      char gfn[1024]= { '\0' };
+      snprintf(gfn, sizeof(gfn), "%s/%s", Input.goldenDir, de->d_name);
+      numFailed+= CheckCompare(gfn, de->d_name);
+    }
+    closedir(d); d= NULL;
+  }
+
+  for(int i= 0; i< MIN(Passes.n, MAX_PASSES); ++i) {
+    const double speed= CheckBudget(Input.budgetSpeed, i), rss= CheckBudget(Input.budgetRSS, i);
+    const bool slow= 0.0< speed&& Passes.MBps[i]< speed;
+    const bool big= 0.0< rss&& Passes.maxRSSMB[i]> rss;
+    printf("%s pass %d: %.1lf MBps (budget %.1lf), peak %.1lf MB (budget %.1lf)\n",
+           slow|| big? "FAIL": "ok  ", i, Passes.MBps[i], speed, Passes.maxRSSMB[i], rss);
+    numFailed+= slow|| big? 1: 0;
+  }
+  printf("check: %s\n", 0== numFailed? "passed": "FAILED");
+  return numFailed;
+}
+
 int main(int argc, char *argv[])
 {
+  const char *const usage= "Usage: ideal2resolved.exe [filter|validate|sample|serve|check] <input-file>\n";
   if(argc< 2) {
-    printf("Usage: notalk.exe <input-file>\n");
+    printf("%s", usage);
+    return 0;
+  }
+  const char *const mode= argc> 2? argv[1]: "resolve";
+  if(0!= strcmp("resolve", mode)&& 0!= strcmp("filter", mode)&& 0!= strcmp("validate", mode)&&
+     0!= strcmp("sample", mode)&& 0!= strcmp("serve", mode)&& 0!= strcmp("check", mode)) {
+    printf("Unknown mode \"%s\"\n%s", mode, usage);
+    return 1;
+  }
+
+  if(0!= FileInput(argv[argc> 2? 2: 1])) {
     return 0;
   }
 
-  if(0!= FileInput(argv[1])) {
+  /* the timelines are allocated and first touched by this thread */
+  ImpPinCurrentThreadToItsNode();
+
+  if(0== strcmp("filter", mode)) {
+    if(NULL== Input.prvfn|| NULL== Input.outfn) {
+      printf("filter needs \"prv-file\" and \"out-file\"\n");
+      return 0;
+    }
+    FilterParaver();
+    return 0;
+  }
+
+  if(NULL== Input.prvfn|| NULL== Input.simfn) {
     return 0;
   }
 
+  if(0== strcmp("validate", mode)) {
+    ValidateTraces();
+    return 0;
+  }
+
+  if(0== strcmp("sample", mode)) {
+    SampleTraces();
+    return 0;
+  }
+
+  if(0== strcmp("serve", mode)) {
+    ServeTraces();
+    return 0;
+  }
+
+  Trace.monRank= Input.monRank;
+  Trace.monThread= Input.monThread;
+
   StoreSimulated();
 
   ProcessParaver();
 
+  if(0== strcmp("check", mode)) {
+    return 0== CheckResults()? 0: 1;
+  }
+
   return 0;
 }
@@ -9,14 +9,23 @@
  * author: Kingshuk Haldar <kingshuk.haldar@hlrs.de>
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include<sys/types.h>
+#include<sys/stat.h>
+#include<sys/sysmacros.h>
+#include<sys/vfs.h>
 #include<unistd.h>
+#include<sched.h>
+#include<dirent.h>
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
 #include<stdbool.h>
 #include<limits.h>
 #include<time.h>
+#include<pthread.h>
 
 
 
@@ -170,6 +179,33 @@ bool ImpEventTypeIsMPI(const long long type)
   return isValid;
 }
 
+/* OpenMP event types of Extrae; 'work' is what threads do for the
+ * application, 'runtime' is waiting in or managing the OpenMP runtime */
+#define NUM_OMP_EVENTS 11
+const long long OMPEventIds[NUM_OMP_EVENTS]= {
+60000001,  /* Parallel region: work */
+60000002,  /* Worksharing: work */
+60000018,  /* Executed outlined (parallel) function: work */
+60000023,  /* Executed task function: work */
+60000005,  /* Barrier: runtime */
+60000006,  /* Unnamed critical: runtime */
+60000007,  /* Named critical: runtime */
+60000016,  /* Join: runtime */
+60000021,  /* Task instantiation: runtime */
+60000022,  /* Taskwait: runtime */
+60000025   /* Taskgroup: runtime */
+};
+#define NUM_OMP_WORK_EVENTS 4
+/* index into OMPEventIds, -1 if not an OpenMP event */
+int ImpOMPEventIndex(const long long type)
+{
+  if(60000001> type|| 60000025< type) { return -1; }
+  for(int i= 0; i< NUM_OMP_EVENTS; ++i) {
+    if(OMPEventIds[i]== type) { return i; }
+  }
+  return -1;
+}
+
 bool ImpMPIEventIdIsGlobal(const int id)
 {
   bool ret= false;
@@ -243,6 +279,25 @@ typedef long long ProfTime;
 #define PROFTIME_MIN LLONG_MIN
 const ProfTime ProfTimeInvalid= -1;
 
+/* Parses a non-negative decimal time-stamp (in ns) up to the first non-digit,
+ * keeping it exact instead of going through a double. */
+inline static ProfTime ImpAtoProfTime(const char *p)
+{
+  ProfTime t= 0;
+  while('0'<= *p&& '9'>= *p) {
+    t= t* 10+ (ProfTime) (*p- '0');
+    ++p;
+  }
+  return t;
+}
+
+/* Writes a time in ns as exact seconds, i.e., "<s>.<9-digit ns>" */
+void ImpFprintSeconds(FILE *const fp, const ProfTime t)
+{
+  const ProfTime a= t< 0? -t: t;
+  fprintf(fp, "%s%lld.%09lld", t< 0? "-": "", a/ 1000000000, a% 1000000000);
+}
+
 long long GetTime()
 {
   struct timespec tp;
@@ -276,6 +331,159 @@ size_t ImpGetNumBytes(FILE *const fp)
   return numBytes;
 }
 
+/* Storage the trace is read from, deciding the block size of the readers */
+typedef enum _ImpStorage_type__ {
+  ImpStorageUnknown= 0,
+  ImpStorageRotational,
+  ImpStorageSolid,
+  ImpStorageVirtual             /* tmpfs, NFS, Lustre, etc. */
+} ImpStorage;
+
+/* Magic numbers of the statfs f_type (see statfs(2)) */
+#define IMP_NFS_MAGIC    0x6969
+#define IMP_LUSTRE_MAGIC 0x0BD00BD0
+#define IMP_GPFS_MAGIC   0x47504653
+#define IMP_TMPFS_MAGIC  0x01021994
+ImpStorage ImpGetStorageType(FILE *const fp, size_t *const blksize)
+{
+  struct stat st;
+  if(0!= fstat(fileno(fp), &st)) { return ImpStorageUnknown; }
+  *blksize= (size_t) MAX(512, st.st_blksize);
+  struct statfs sf;
+  if(0== fstatfs(fileno(fp), &sf)) {
+    switch((unsigned long) sf.f_type) {
+    case IMP_NFS_MAGIC: case IMP_LUSTRE_MAGIC: case IMP_GPFS_MAGIC: case IMP_TMPFS_MAGIC:
+      return ImpStorageVirtual;
+    default: break;
+    }
+  }
+  /* btrfs, overlayfs, ZFS, etc. have anonymous devices without a queue */
+  if(0== major(st.st_dev)) { return ImpStorageUnknown; }
+
+  char path[128]= { '\0' };
+  sprintf(path, "/sys/dev/block/%u:%u/queue/rotational", major(st.st_dev), minor(st.st_dev));
+  FILE *sfp= fopen(path, "r");
+  if(NULL== sfp) {              /* a partition, the queue is at its disk */
+    sprintf(path, "/sys/dev/block/%u:%u/../queue/rotational", major(st.st_dev), minor(st.st_dev));
+    sfp= fopen(path, "r");
+  }
+  if(NULL== sfp) { return ImpStorageUnknown; }
+  int rot= -1;
+  if(1!= fscanf(sfp, "%d", &rot)) { rot= -1; }
+  fclose(sfp); sfp= NULL;
+  return 1== rot? ImpStorageRotational: 0== rot? ImpStorageSolid: ImpStorageUnknown;
+}
+
+/* Block size of a reader: long sequential requests for spinning disks and
+ * parallel file-systems, shorter ones for SSDs, at least 4 MB per parsing
+ * thread, never (much) more than the file itself, and a multiple of the
+ * file-system's block size */
+size_t ImpGetBlockSize(FILE *const fp, const size_t numBytes, const int numThreads)
+{
+#define MB (1024*1024)
+  size_t blksize= 4096;
+  size_t len= 32* MB;
+  switch(ImpGetStorageType(fp, &blksize)) {
+  case ImpStorageRotational: len= 64* MB; break;
+  case ImpStorageSolid:      len= 16* MB; break;
+  case ImpStorageVirtual:    len= 64* MB; break;
+  default: break;
+  }
+  len= MIN(MAX(len, ((size_t) MAX(1, numThreads))* 4* MB), 256* MB);
+  len= MAX(MIN(len, numBytes+ 2), 64* 1024);
+  len= (len+ blksize- 1)/ blksize* blksize;
+#undef MB
+  return len;
+}
+
+/* CPUs the process may run on with their NUMA nodes, interleaved across the
+ * nodes so that consecutive parser threads are spread over the sockets */
+static struct {
+  int n;
+  int *cpu;
+  int *node;
+} ImpTopology= { 0, NULL, NULL };
+bool ImpPinThreads= true;
+
+int ImpCpuNumaNode(const int cpu)
+{
+  char path[64]= { '\0' };
+  sprintf(path, "/sys/devices/system/cpu/cpu%d", cpu);
+  DIR *d= opendir(path);
+  if(NULL== d) { return 0; }
+  int node= 0;
+  struct dirent *de= NULL;
+  while(NULL!= (de= readdir(d))) {
+    if(0== strncmp("node", de->d_name, 4)&& '0'<= de->d_name[4]&& '9'>= de->d_name[4]) {
+      node= atoi(de->d_name+ 4);
+      break;
+    }
+  }
+  closedir(d); d= NULL;
+  return node;
+}
+
+static int ImpCompareCpuSlot(const void *a, const void *b)
+{
+  const int *const x= (const int *) a, *const y= (const int *) b;
+  return x[2]!= y[2]? x[2]- y[2]: x[1]!= y[1]? x[1]- y[1]: x[0]- y[0];
+}
+void ImpInitTopology()
+{
+  if(0< ImpTopology.n) { return; }
+  cpu_set_t set; CPU_ZERO(&set);
+  if(0!= sched_getaffinity(0, sizeof(set), &set)) { return; }
+  const int ncpu= CPU_COUNT(&set);
+  int (*slot)[3]= (int (*)[3]) malloc(sizeof(int[3])* MAX(1, ncpu));  /* cpu, node, index in node */
+  int n= 0;
+  for(int c= 0; c< CPU_SETSIZE&& n< ncpu; ++c) {
+    if(!CPU_ISSET(c, &set)) { continue; }
+    slot[n][0]= c;
+    slot[n][1]= ImpCpuNumaNode(c);
+    slot[n][2]= 0;
+    for(int i= 0; i< n; ++i) {
+      if(slot[i][1]== slot[n][1]) { ++(slot[n][2]); }
+    }
+    ++n;
+  }
+  qsort(slot, n, sizeof(int[3]), &ImpCompareCpuSlot);
+  ImpTopology.cpu= (int *) malloc(sizeof(int)* MAX(1, n));
+  ImpTopology.node= (int *) malloc(sizeof(int)* MAX(1, n));
+  for(int i= 0; i< n; ++i) {
+    ImpTopology.cpu[i]= slot[i][0];
+    ImpTopology.node[i]= slot[i][1];
+  }
+  ImpTopology.n= n;
+  FREE_IF(slot);
+}
+
+/* Pins the thread created with 'attr' for parser 'tid' */
+void ImpSetParserAffinity(pthread_attr_t *const attr, const int tid)
+{
+  if(!ImpPinThreads|| 0== ImpTopology.n) { return; }
+  cpu_set_t set; CPU_ZERO(&set);
+  CPU_SET(ImpTopology.cpu[tid% ImpTopology.n], &set);
+  pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+/* Keeps the calling thread on the NUMA node it is running on, so that what it
+ * allocates and touches first, e.g., the timelines, stays local to it */
+void ImpPinCurrentThreadToItsNode()
+{
+  ImpInitTopology();
+  if(!ImpPinThreads|| 0== ImpTopology.n) { return; }
+  const int cpu= sched_getcpu();
+  if(0> cpu) { return; }
+  const int node= ImpCpuNumaNode(cpu);
+  cpu_set_t set; CPU_ZERO(&set);
+  for(int i= 0; i< ImpTopology.n; ++i) {
+    if(node== ImpTopology.node[i]) { CPU_SET(ImpTopology.cpu[i], &set); }
+  }
+  if(0< CPU_COUNT(&set)) {
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+}
+
 inline static char *ImpNthNum(char *const p, const int n)
 {
   char *ptr= p;
@@ -290,10 +498,57 @@ typedef struct _PrvHeader_type__ {
   int numNodes;
   int numProcs;
   int numComms;
+  int numTasks;
+  int numThreads;               /* of all tasks */
+  int *threadOff;               /* numTasks+ 1, first timeline of each task */
 } PrvHeader;
 
 extern PrvHeader header;
 
+/* Timelines of the (first) application, one per (task, thread), from
+ * ":nAppl:nTasks(nThreads:node,...),nComms"; one thread per CPU if absent */
+static void ImpProcessParaverApplication(const char *const appl)
+{
+  FREE_IF(header.threadOff);
+  const char *ptr= strchr(appl, ':');
+  ptr= NULL== ptr? NULL: strchr(ptr+ 1, ':');
+  const char *list= NULL== ptr? NULL: strchr(ptr, '(');
+  header.numTasks= NULL== list? 0: atoi(ptr+ 1);
+  if(0>= header.numTasks) {
+    header.numTasks= header.numProcs;
+    list= NULL;
+  }
+  header.threadOff= (int *) malloc(sizeof(int)* (header.numTasks+ 1));
+  header.threadOff[0]= 0;
+  for(int i= 0; i< header.numTasks; ++i) {
+    int nth= 1;
+    if(NULL!= list) {
+      nth= atoi(list+ 1);
+      list= strchr(list+ 1, ',');
+    }
+    header.threadOff[i+ 1]= header.threadOff[i]+ MAX(1, nth);
+  }
+  header.numThreads= header.threadOff[header.numTasks];
+}
+
+/* 0-based task and thread to timeline, -1 if out of range */
+inline static int ImpTimelineIndex(const int task, const int thread)
+{
+  if(0> task|| header.numTasks<= task|| 0> thread) { return -1; }
+  const int it= header.threadOff[task]+ thread;
+  return it< header.threadOff[task+ 1]? it: -1;
+}
+/* 0-based task of a timeline */
+int ImpTimelineTask(const int it)
+{
+  int lo= 0, hi= header.numTasks;
+  while(hi- lo> 1) {
+    const int mid= (lo+ hi)/ 2;
+    if(header.threadOff[mid]<= it) { lo= mid; } else { hi= mid; }
+  }
+  return lo;
+}
+
 static void printProgramRuntimeWithDot(const long long rt, const char *const u, const int numdots)
 {
   long long d= 1;
@@ -344,7 +599,7 @@ void ImpProcessParaverHeader(FILE *fp)
   }
   ptr= strtok(NULL, ")"); header.numProcs+= atoi(ptr);
 
-  ptr= strtok(NULL, "\n"); ptr= strrchr(ptr, ',');
+  ptr= strtok(NULL, "\n"); ImpProcessParaverApplication(ptr); ptr= strrchr(ptr, ',');
   char a[32]= { '\0' }; strcpy(a, ptr+ 1); if(strchr(a, ')')) { return; }
   header.numComms= atoi(a);
   for(int i= 0; i< header.numComms; ++i) {
@@ -392,7 +647,7 @@ void ImpProcessParaverFileWithNumBytes(FILE *fp, const size_t numBytes)
     printf("Size after comms section: %.1lf MB\n", ((double) numBytes)/ 1024.0/ 1024.0);
     printf("Processed %02d%%...", 0); fflush(stdout);
   }
-  const size_t buflen= 32*1024*1024;
+  const size_t buflen= ImpGetBlockSize(fp, numBytes, 1);
   char *buf= malloc(sizeof(char)* (buflen+ 1)); buf[buflen]= '\0';
   size_t car= 0, rem= buflen- 1, numBytesRead= 0, numBytesProcessed= 0;
 
@@ -414,6 +669,121 @@ void ImpProcessParaverFileWithNumBytes(FILE *fp, const size_t numBytes)
   if(buf) { free(buf); buf= NULL; }
 }
 
+typedef struct _ImpChunk_type__ {
+  char *buf;
+  size_t len;
+  char *local;                  /* first touched by the (pinned) worker */
+  size_t cap;
+  size_t pos;                   /* offset from where the reading started */
+  int tid;
+  void (*fn)(char *const, const int, const size_t);
+} ImpChunk;
+
+/* Splits a buffer of 'len' bytes into at most 'n' newline-aligned chunks,
+ * '\0'-terminating each of them in place; returns the number of chunks. */
+static int ImpSplitBuffer(char *const buf, const size_t len, const int n, ImpChunk *const chunks)
+{
+  int nc= 0;
+  size_t s= 0;
+  for(int i= 0; i< n&& s< len; ++i) {
+    size_t e= i== n- 1? len: MAX(s, len/ n* (i+ 1));
+    while(e< len&& '\n'!= buf[e]) { ++e; }
+    buf[e]= '\0';
+    chunks[nc].buf= buf+ s;
+    chunks[nc].len= e- s;
+    ++nc;
+    s= e+ 1;
+  }
+  return nc;
+}
+
+/* The chunk is copied once into the worker's own buffer, so that parsing,
+ * which touches every byte several times, only hits local memory. */
+static void *ImpChunkWorker(void *arg)
+{
+  ImpChunk *const c= (ImpChunk *) arg;
+  if(c->cap< c->len+ 1) {
+    FREE_IF(c->local);
+    c->cap= MAX(2* c->cap, c->len+ 1);
+    c->local= (char *) malloc(sizeof(char)* c->cap);
+    memset(c->local, 0, sizeof(char)* c->cap);
+  }
+  memcpy(c->local, c->buf, c->len+ 1);
+  c->fn(c->local, c->tid, c->pos);
+  return NULL;
+}
+
+/* Multi-threaded counterpart of ImpProcessParaverFileWithNumBytes: every block
+ * is split into 'numThreads' newline-aligned chunks, each handed to 'fn' on its
+ * own thread while the next block is being read, along with the chunk's
+ * offset from the initial position of 'fp'.  Once a block is done, 'flush' is
+ * called from the calling thread for each chunk in file order. */
+void ImpProcessParaverFileParallelWithNumBytes(FILE *fp, const size_t numBytes, const int numThreads,
+                                               void (*fn)(char *const, const int, const size_t),
+                                               void (*flush)(const int))
+{
+  if(!ImpProcessParaverBufferSilently) {
+    printf("Size after comms section: %.1lf MB\n", ((double) numBytes)/ 1024.0/ 1024.0);
+    printf("Processed %02d%%...", 0); fflush(stdout);
+  }
+  const int nt= MAX(1, numThreads);
+  const size_t buflen= ImpGetBlockSize(fp, numBytes, nt);
+  char *buf[2]= { malloc(sizeof(char)* (buflen+ 1)), malloc(sizeof(char)* (buflen+ 1)) };
+  pthread_t *threads= (pthread_t *) malloc(sizeof(pthread_t)* nt);
+  pthread_attr_t *attrs= (pthread_attr_t *) malloc(sizeof(pthread_attr_t)* nt);
+  ImpChunk *work= (ImpChunk *) malloc(sizeof(ImpChunk)* nt);
+  memset(work, 0, sizeof(ImpChunk)* nt);
+  bool *started= (bool *) malloc(sizeof(bool)* nt);
+  ImpInitTopology();
+  for(int i= 0; i< nt; ++i) {
+    pthread_attr_init(&attrs[i]);
+    ImpSetParserAffinity(&attrs[i], i);
+  }
+  size_t numBytesRead= 0, numBytesProcessed= 0;
+  int cur= 0;
+
+  numBytesRead= TimedFread(buf[cur], 1, buflen, fp);
+  while(0!= numBytesRead) {
+    size_t len= ImpGetLastNewlinePos(buf[cur], buflen, numBytesRead);
+    if(ULLONG_MAX== len) { len= numBytesRead; }  /* no newline left, take all */
+    buf[cur][len]= '\0';
+    const size_t car= numBytesRead> len? numBytesRead- len- 1: 0;
+    memcpy(buf[1- cur], buf[cur]+ len+ 1, car);
+
+    const int nc= ImpSplitBuffer(buf[cur], len, nt, work);
+    for(int i= 0; i< nc; ++i) {
+      work[i].tid= i; work[i].fn= fn;
+      work[i].pos= numBytesProcessed+ (size_t) (work[i].buf- buf[cur]);
+      /* without a thread (e.g. EAGAIN, or EINVAL from the affinity), the
+       * chunk is parsed right here */
+      started[i]= 0== pthread_create(&threads[i], &attrs[i], &ImpChunkWorker, &work[i]);
+      if(!started[i]) { ImpChunkWorker(&work[i]); }
+    }
+    numBytesRead= TimedFread(buf[1- cur]+ car, 1, buflen- car, fp)+ car;
+    for(int i= 0; i< nc; ++i) {
+      if(started[i]) { pthread_join(threads[i], NULL); }
+    }
+    if(NULL!= flush) {
+      for(int i= 0; i< nc; ++i) { flush(i); }
+    }
+
+    numBytesProcessed+= len+ 1;
+    cur= 1- cur;
+    if(!ImpProcessParaverBufferSilently) {
+      printf("\rProcessed %02d%%...", (int) (MIN(numBytesProcessed, numBytes)* 100/ MAX(numBytes, 1))); fflush(stdout);
+    }
+  }
+  if(!ImpProcessParaverBufferSilently) {
+    printf("\n"); fflush(stdout);
+  }
+  for(int i= 0; i< nt; ++i) {
+    FREE_IF(work[i].local);
+    pthread_attr_destroy(&attrs[i]);
+  }
+  FREE_IF(work); FREE_IF(attrs); FREE_IF(threads); FREE_IF(started);
+  FREE_IF(buf[1]); FREE_IF(buf[0]);
+}
+
 void ImpProcessParaverFile(FILE *fp)
 {
   const size_t numBytes= ImpGetNumBytes(fp);
@@ -465,6 +835,63 @@ ProfTime ImpGetTimePointNS(const char *const input)
   return tp;
 }
 
+/* List of closed ranges, e.g., "1,4-7"; an empty list selects everything */
+typedef struct _ImpRangeList_type__ {
+  int n;
+  long long (*r)[2];
+} ImpRangeList;
+
+void ImpParseRangeList(const char *const s, ImpRangeList *const rl)
+{
+  rl->n= 0; rl->r= NULL;
+  if(NULL== s) { return; }
+  int cap= 0;
+  const char *ptr= s;
+  while('\0'!= *ptr) {
+    char *end= NULL;
+    const long long a= strtoll(ptr, &end, 10);
+    if(end== ptr) { ++ptr; continue; }
+    long long b= a;
+    ptr= end;
+    if('-'== *ptr) {
+      b= strtoll(ptr+ 1, &end, 10);
+      ptr= end;
+    }
+    if(rl->n== cap) {
+      cap= 0== cap? 8: 2* cap;
+      rl->r= (long long (*)[2]) realloc(rl->r, sizeof(long long[2])* cap);
+    }
+    rl->r[rl->n][0]= MIN(a,b); rl->r[rl->n][1]= MAX(a,b);
+    ++(rl->n);
+  }
+}
+
+inline static bool ImpRangeListHas(const ImpRangeList *const rl, const long long v)
+{
+  if(0== rl->n) { return true; }
+  for(int i= 0; i< rl->n; ++i) {
+    if(rl->r[i][0]<= v&& v<= rl->r[i][1]) { return true; }
+  }
+  return false;
+}
+
+/* Growable output buffer, e.g., one per parsing thread */
+typedef struct _ImpOutBuf_type__ {
+  char *buf;
+  size_t len;
+  size_t cap;
+} ImpOutBuf;
+
+inline static void ImpOutBufAppend(ImpOutBuf *const ob, const char *const p, const size_t n)
+{
+  if(ob->len+ n> ob->cap) {
+    ob->cap= MAX(2* ob->cap, ob->len+ n+ 4096);
+    ob->buf= (char *) realloc(ob->buf, sizeof(char)* ob->cap);
+  }
+  memcpy(ob->buf+ ob->len, p, n);
+  ob->len+= n;
+}
+
 bool ImpArgvHelpNeeded(const int argc, char **const argv)
 {
   const bool ret= 0== strcmp("-h", argv[1])|| 0== strcmp("--help", argv[1]);
@@ -473,7 +900,8 @@ bool ImpArgvHelpNeeded(const int argc, char **const argv)
 
 /* pass: 0, 1, 2, etc. */
 /* factor: multiplication factor to make it ns */
-void ImpPrintSpeed(const int pass, const size_t B, const ProfTime readtime, const size_t factor)
+/* returns the speed in Bps */
+double ImpPrintSpeed(const int pass, const size_t B, const ProfTime readtime, const size_t factor)
 {
   const double rts= ((double) (readtime* factor))* 1.0e-9;
   printf(" Pass %2d: %.3lf s (speed: ", pass, rts);
@@ -488,6 +916,7 @@ void ImpPrintSpeed(const int pass, const size_t B, const ProfTime readtime, cons
     printf("%.0lf Bps", Bps);
   }
   printf("); I/O calls: %.3lf s\n", ((double) ImpFreadTime)* 1.0e-9);
+  return Bps;
 }
 
 int ImpArrayElemMax_int(const int *const arr, const size_t n)